@@ -5,6 +5,8 @@ from .python.utils import logger # noqa: F401
 from .python import (Panda, PandaDFU, # noqa: F401
                      pack_can_buffer, unpack_can_buffer, calculate_checksum,
                      DLC_TO_LEN, LEN_TO_DLC, CANPACKET_HEAD_SIZE)
+from .python.pool import PandaPool # noqa: F401
+from .python.asyncpanda import AsyncPanda # noqa: F401
 
 # panda jungle
 from .board.jungle import PandaJungle, PandaJungleDFU # noqa: F401
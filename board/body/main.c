@@ -6,6 +6,7 @@
 #include "board/drivers/pwm.h"
 #include "board/drivers/usb.h"
 #include "board/early_init.h"
+#include "board/boot_profile.h"
 #include "board/obj/gitversion.h"
 #include "board/body/can.h"
 #include "opendbc/safety/safety.h"
@@ -50,8 +51,9 @@ void bldc_tim8_handler(void) {
 void tick_handler(void) {
   if (TICK_TIMER->SR != 0) {
     if (can_health[0].transmit_error_cnt >= 128) {
-      (void)llcan_init(CANIF_FROM_CAN_NUM(0));
+      (void)can_init(0);
     }
+    can_init_tick();
     static bool led_on = false;
     led_set(LED_RED, led_on);
     led_on = !led_on;
@@ -1,6 +1,17 @@
-void comms_endpoint2_write(const uint8_t *data, uint32_t len) {
+bool comms_endpoint2_write(const uint8_t *data, uint32_t len) {
   UNUSED(data);
   UNUSED(len);
+  return true;
+}
+
+bool comms_endpoint2_ready(void) {
+  return true;
+}
+
+int comms_serial_read(uint8_t *data, uint32_t max_len) {
+  UNUSED(data);
+  UNUSED(max_len);
+  return 0;
 }
 
 int comms_control_handler(ControlPacket_t *req, uint8_t *resp) {
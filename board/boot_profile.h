@@ -0,0 +1,86 @@
+// Boot timing, written by the bootstub and the app and read back over 0xa9.
+// Lives at a fixed address at the end of SRAM4 (see the linker script), which
+// isn't touched by the startup code, so it survives the jump into the app.
+#define BOOT_PROFILE_HANDOFF 0xb0070000U  // bootstub is done, app continues the record
+#define BOOT_PROFILE_MAGIC 0xb0070001U    // app has taken over, record is readable
+
+// bootstub
+// clock_init() runs on the 64MHz HSI up to the switch to the PLL. The few register writes
+// after the switch run at CORE_FREQ but are counted at HSI_FREQ, which overstates the stage
+// by well under 1us. The HSE, PLL and VOS waits before the switch are timed correctly.
+#define BOOT_STAGE_CLOCK_INIT 0U
+#define BOOT_STAGE_BOARD_DETECT 1U  // detect_board_type()
+#define BOOT_STAGE_SHA 2U           // SHA1 over the app image
+#define BOOT_STAGE_RSA 3U           // signature check
+// app
+#define BOOT_STAGE_APP_EARLY 4U     // clocks, peripherals, board detection, ADC1
+#define BOOT_STAGE_APP_BOARD 5U     // board init, timers
+#define BOOT_STAGE_APP_CAN 6U       // FDCAN cores and transceivers
+#define BOOT_STAGE_APP_ANALOG 7U    // harness detection incl. AVDD calibration, fan
+#define BOOT_STAGE_APP_SAFETY 8U    // SILENT safety mode
+#define BOOT_STAGE_APP_COMMS 9U     // watchdog, tick timer, USB and SPI
+#define BOOT_STAGE_FIRST_RX 10U     // interrupts on to first received CAN frame
+#define BOOT_STAGE_COUNT 11U
+
+#define HSI_FREQ 64U // in Mhz, core clock before clock_init()
+
+typedef struct __attribute__((packed)) {
+  uint32_t magic;
+  uint32_t app_len;
+  uint32_t stage_us[BOOT_STAGE_COUNT];
+  uint32_t last_cycles;  // DWT->CYCCNT at the end of the previous stage
+} boot_profile_t;
+
+extern boot_profile_t boot_profile;
+
+// stages are timed with the DWT cycle counter, the timers aren't set up in the bootstub
+void boot_profile_init(void) {
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->LAR = 0xC5ACCE55U; // unlock
+  DWT->CYCCNT = 0U;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+  boot_profile.magic = 0U;
+  boot_profile.app_len = 0U;
+  for (uint32_t i = 0U; i < BOOT_STAGE_COUNT; i++) {
+    boot_profile.stage_us[i] = 0U;
+  }
+  boot_profile.last_cycles = 0U;
+}
+
+// ends a stage that ran at freq Mhz, the next one starts now
+void boot_profile_stage(uint32_t stage, uint32_t freq) {
+  uint32_t now = DWT->CYCCNT;
+  boot_profile.stage_us[stage] = (now - boot_profile.last_cycles) / freq;
+  boot_profile.last_cycles = now;
+}
+
+#ifndef BOOTSTUB
+static bool boot_profile_rx_pending = false;
+static uint32_t boot_profile_rx_start = 0U;
+
+// continue the bootstub's record, or start a fresh one if we weren't jumped to by it
+void boot_profile_app_start(void) {
+  if (boot_profile.magic != BOOT_PROFILE_HANDOFF) {
+    boot_profile_init();
+  }
+  boot_profile.magic = BOOT_PROFILE_MAGIC;
+}
+
+// the wait for the first frame can be long, so it's timed with the microsecond timer
+void boot_profile_rx_arm(void) {
+  boot_profile_rx_start = microsecond_timer_get();
+  boot_profile_rx_pending = true;
+}
+
+void boot_profile_rx(void) {
+  if (boot_profile_rx_pending) {
+    boot_profile.stage_us[BOOT_STAGE_FIRST_RX] = get_ts_elapsed(microsecond_timer_get(), boot_profile_rx_start);
+    boot_profile_rx_pending = false;
+  }
+}
+
+bool boot_profile_valid(void) {
+  return boot_profile.magic == BOOT_PROFILE_MAGIC;
+}
+#endif
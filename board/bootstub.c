@@ -9,6 +9,7 @@
 #include "board/drivers/usb.h"
 
 #include "board/early_init.h"
+#include "board/boot_profile.h"
 #include "board/provision.h"
 
 #include "board/crypto/rsa.h"
@@ -30,13 +31,29 @@ void fail(void) {
 // know where to sig check
 extern void *_app_start[];
 
+// hot code that runs from ITCM, see the linker script
+extern uint32_t _siitcm[];
+extern uint32_t _sitcm[];
+extern uint32_t _eitcm[];
+
+static void itcm_text_init(void) {
+  for (uint32_t i = 0U; &_sitcm[i] < _eitcm; i++) {
+    _sitcm[i] = _siitcm[i];
+  }
+}
+
 int main(void) {
   // Init interrupt table
   init_interrupts(true);
 
   disable_interrupts();
+  boot_profile_init();
   clock_init();
+  boot_profile_stage(BOOT_STAGE_CLOCK_INIT, HSI_FREQ);
   detect_board_type();
+  boot_profile_stage(BOOT_STAGE_BOARD_DETECT, CORE_FREQ);
+
+  itcm_text_init();
 
 #ifdef PANDA_JUNGLE
   current_board->set_panda_power(true);
@@ -54,6 +71,8 @@ int main(void) {
   // compute SHA hash
   uint8_t digest[SHA_DIGEST_SIZE];
   SHA_hash(&_app_start[1], len-4, digest);
+  boot_profile_stage(BOOT_STAGE_SHA, CORE_FREQ);
+  boot_profile.app_len = (uint32_t)len;
 
   // verify version, last bytes in the signed area
   uint32_t vers[2] = {0};
@@ -79,6 +98,9 @@ fail:
   fail();
   return 0;
 good:
+  boot_profile_stage(BOOT_STAGE_RSA, CORE_FREQ);
+  boot_profile.magic = BOOT_PROFILE_HANDOFF;
+
   // jump to flash
   ((void(*)(void)) _app_start[1])();
   return 0;
@@ -43,6 +43,7 @@ typedef struct {
 static asm_buffer can_read_buffer = {.ptr = 0U, .tail_size = 0U};
 
 int comms_can_read(uint8_t *data, uint32_t max_len) {
+  PROBE_BEGIN(PROBE_COMMS_CAN_READ);
   uint32_t pos = 0U;
 
   // Send tail of previous message if it is in buffer
@@ -72,6 +73,8 @@ int comms_can_read(uint8_t *data, uint32_t max_len) {
     }
   }
 
+  TRACE(TRACE_COMMS_CAN_READ, (uint16_t)pos, can_slots_empty(&can_rx_q));
+  PROBE_END(PROBE_COMMS_CAN_READ);
   return pos;
 }
 
@@ -79,6 +82,7 @@ static asm_buffer can_write_buffer = {.ptr = 0U, .tail_size = 0U};
 
 // send on CAN
 void comms_can_write(const uint8_t *data, uint32_t len) {
+  PROBE_BEGIN(PROBE_COMMS_CAN_WRITE);
   uint32_t pos = 0U;
 
   // Assembling can message with data from buffer
@@ -124,6 +128,8 @@ void comms_can_write(const uint8_t *data, uint32_t len) {
   }
 
   refresh_can_tx_slots_available();
+  TRACE(TRACE_COMMS_CAN_WRITE, (uint16_t)len, MIN(MIN(can_slots_empty(&can_tx1_q), can_slots_empty(&can_tx2_q)), can_slots_empty(&can_tx3_q)));
+  PROBE_END(PROBE_COMMS_CAN_WRITE);
 }
 
 void comms_can_reset(void) {
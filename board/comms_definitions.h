@@ -8,7 +8,9 @@ typedef struct {
 } __attribute__((packed)) ControlPacket_t;
 
 int comms_control_handler(ControlPacket_t *req, uint8_t *resp);
-void comms_endpoint2_write(const uint8_t *data, uint32_t len);
+bool comms_endpoint2_write(const uint8_t *data, uint32_t len);
+bool comms_endpoint2_ready(void);
 void comms_can_write(const uint8_t *data, uint32_t len);
 int comms_can_read(uint8_t *data, uint32_t max_len);
+int comms_serial_read(uint8_t *data, uint32_t max_len);
 void comms_can_reset(void);
@@ -25,62 +25,65 @@
 ** ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
-// Optimized for minimal code size.
+// Optimized for speed: the bootstub hashes the whole app image on every boot.
+// The rounds are unrolled over a 16-word rolling schedule, and whole blocks are
+// hashed straight from word-aligned input (i.e. flash) instead of being copied
+// through ctx->buf one byte at a time.
 
 void *memcpy(void *str1, const void *str2, unsigned int n);
 
 #include "sha.h"
 
-#define rol(bits, value) (((value) << (bits)) | ((value) >> (32 - (bits))))
-
-static void SHA1_Transform(SHA_CTX* ctx) {
-    uint32_t W[80];
-    uint32_t A, B, C, D, E;
-    uint8_t* p = ctx->buf;
-    int t;
-
-    for(t = 0; t < 16; ++t) {
-        uint32_t tmp =  *p++ << 24;
-        tmp |= *p++ << 16;
-        tmp |= *p++ << 8;
-        tmp |= *p++;
-        W[t] = tmp;
-    }
+// in the bootstub, the transform runs from ITCM (see .itcm_text in the linker script)
+#ifdef BOOTSTUB
+  #define SHA_FAST_CODE __attribute__((section(".itcm_text"), long_call, noinline))
+#else
+  #define SHA_FAST_CODE
+#endif
 
-    for(; t < 80; t++) {
-        W[t] = rol(1,W[t-3] ^ W[t-8] ^ W[t-14] ^ W[t-16]);
-    }
-
-    A = ctx->state[0];
-    B = ctx->state[1];
-    C = ctx->state[2];
-    D = ctx->state[3];
-    E = ctx->state[4];
-
-    for(t = 0; t < 80; t++) {
-        uint32_t tmp = rol(5,A) + E + W[t];
-
-        if (t < 20)
-            tmp += (D^(B&(C^D))) + 0x5A827999;
-        else if ( t < 40)
-            tmp += (B^C^D) + 0x6ED9EBA1;
-        else if ( t < 60)
-            tmp += ((B&C)|(D&(B|C))) + 0x8F1BBCDC;
-        else
-            tmp += (B^C^D) + 0xCA62C1D6;
-
-        E = D;
-        D = C;
-        C = rol(30,B);
-        B = A;
-        A = tmp;
-    }
+#define rol(bits, value) (((value) << (bits)) | ((value) >> (32 - (bits))))
 
-    ctx->state[0] += A;
-    ctx->state[1] += B;
-    ctx->state[2] += C;
-    ctx->state[3] += D;
-    ctx->state[4] += E;
+#define F0(b, c, d) ((d) ^ ((b) & ((c) ^ (d))))
+#define F1(b, c, d) ((b) ^ (c) ^ (d))
+#define F2(b, c, d) (((b) & (c)) | ((d) & ((b) | (c))))
+#define F3(b, c, d) F1(b, c, d)
+
+// W[t] for t < 16 is loaded big-endian from the block, after that it's
+// W[t-3] ^ W[t-8] ^ W[t-14] ^ W[t-16] rotated, kept in a 16-entry ring
+#define W(t) (((t) < 16) ? \
+  (W[(t) & 15] = __builtin_bswap32(blk[(t) & 15])) : \
+  (W[(t) & 15] = rol(1, W[((t) + 13) & 15] ^ W[((t) + 8) & 15] ^ W[((t) + 2) & 15] ^ W[(t) & 15])))
+
+#define R(a, b, c, d, e, f, k, t) \
+  e += rol(5, a) + f(b, c, d) + (k) + W(t); \
+  b = rol(30, b);
+
+#define R5(f, k, t) \
+  R(A, B, C, D, E, f, k, (t)) \
+  R(E, A, B, C, D, f, k, (t) + 1) \
+  R(D, E, A, B, C, f, k, (t) + 2) \
+  R(C, D, E, A, B, f, k, (t) + 3) \
+  R(B, C, D, E, A, f, k, (t) + 4)
+
+// blk must be 4-byte aligned
+SHA_FAST_CODE static void SHA1_Transform(uint32_t* state, const uint32_t* blk) {
+    uint32_t W[16];
+    uint32_t A = state[0];
+    uint32_t B = state[1];
+    uint32_t C = state[2];
+    uint32_t D = state[3];
+    uint32_t E = state[4];
+
+    R5(F0, 0x5A827999, 0)  R5(F0, 0x5A827999, 5)  R5(F0, 0x5A827999, 10) R5(F0, 0x5A827999, 15)
+    R5(F1, 0x6ED9EBA1, 20) R5(F1, 0x6ED9EBA1, 25) R5(F1, 0x6ED9EBA1, 30) R5(F1, 0x6ED9EBA1, 35)
+    R5(F2, 0x8F1BBCDC, 40) R5(F2, 0x8F1BBCDC, 45) R5(F2, 0x8F1BBCDC, 50) R5(F2, 0x8F1BBCDC, 55)
+    R5(F3, 0xCA62C1D6, 60) R5(F3, 0xCA62C1D6, 65) R5(F3, 0xCA62C1D6, 70) R5(F3, 0xCA62C1D6, 75)
+
+    state[0] += A;
+    state[1] += B;
+    state[2] += C;
+    state[3] += D;
+    state[4] += E;
 }
 
 static const HASH_VTAB SHA_VTAB = {
@@ -108,11 +111,19 @@ void SHA_update(SHA_CTX* ctx, const void* data, int len) {
 
     ctx->count += len;
 
-    while (len--) {
-        ctx->buf[i++] = *p++;
-        if (i == 64) {
-            SHA1_Transform(ctx);
-            i = 0;
+    while (len > 0) {
+        if ((i == 0) && (len >= 64) && ((((uintptr_t)p) & 3U) == 0U)) {
+            // whole block, hash it in place
+            SHA1_Transform(ctx->state, (const uint32_t*)p);
+            p += 64;
+            len -= 64;
+        } else {
+            ctx->buf[i++] = *p++;
+            len--;
+            if (i == 64) {
+                SHA1_Transform(ctx->state, (const uint32_t*)ctx->buf);
+                i = 0;
+            }
         }
     }
 }
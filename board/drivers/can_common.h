@@ -234,7 +234,13 @@ bool can_check_checksum(CANPacket_t *packet) {
 }
 
 void can_send(CANPacket_t *to_push, uint8_t bus_number, bool skip_tx_hook) {
-  if (skip_tx_hook || safety_tx_hook(to_push) != 0) {
+  bool allowed = skip_tx_hook;
+  if (!allowed) {
+    PROBE_BEGIN(PROBE_SAFETY_TX);
+    allowed = (safety_tx_hook(to_push) != 0);
+    PROBE_END(PROBE_SAFETY_TX);
+  }
+  if (allowed) {
     if (bus_number < PANDA_CAN_CNT) {
       // add CAN packet to send queue
       tx_buffer_overflow += can_push(can_queues[bus_number], to_push) ? 0U : 1U;
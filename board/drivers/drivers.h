@@ -105,7 +105,8 @@ void fan_init(void);
 void fan_tick(void);
 
 // ******************** fdcan ********************
-#ifdef STM32H7
+// also built for the host FDCAN simulator, see tests/libpanda/fdcan_sim.c
+#if defined(STM32H7) || defined(FDCAN_SIM)
 
 typedef struct {
   volatile uint32_t header[2];
@@ -116,6 +117,17 @@ extern FDCAN_GlobalTypeDef *cans[PANDA_CAN_CNT];
 
 #define CAN_ACK_ERROR 3U
 
+typedef struct __attribute__((packed)) {
+  uint8_t busy;           // (re)initialization in progress
+  uint32_t last_time_us;  // how long the last (re)initialization took
+  uint32_t max_time_us;
+  uint32_t cnt;
+  uint32_t timeout_cnt;
+  uint8_t faulted;        // the last (re)initialization timed out, the core is off the bus
+} can_init_stats_t;
+extern can_init_stats_t can_init_stats[PANDA_CAN_CNT];
+
+void can_init_tick(void);
 void can_clear_send(FDCAN_GlobalTypeDef *FDCANx, uint8_t can_number);
 void update_can_health_pkt(uint8_t can_number, uint32_t ir_reg);
 
@@ -123,6 +135,7 @@ void process_can(uint8_t can_number);
 void can_rx(uint8_t can_number);
 bool can_init(uint8_t can_number);
 
+#ifdef STM32H7
 // ******************** harness ********************
 
 #define HARNESS_STATUS_NC 0U
@@ -134,7 +147,11 @@ struct harness_t {
   uint16_t sbu1_voltage_mV;
   uint16_t sbu2_voltage_mV;
   bool relay_driven;
-  bool sbu_adc_lock;
+  volatile uint32_t sbu_seq;    // odd while the SBU pins are in analog mode
+  bool sbu_scanning;            // the SBU channels are in the ADC scan
+  bool ignition;                // ignition line from before the current measurement
+  uint32_t sbu_measure_start;   // when the SBU pins went to analog mode
+  uint32_t sbu_measure_max_us;  // worst case time the SBU pins spent in analog mode
 };
 extern struct harness_t harness;
 
@@ -156,6 +173,7 @@ void set_intercept_relay(bool intercept, bool ignition_relay);
 bool harness_check_ignition(void);
 void harness_tick(void);
 void harness_init(void);
+#endif // STM32H7
 
 // ******************** interrupts ********************
 
@@ -184,18 +202,32 @@ extern interrupt interrupts[NUM_INTERRUPTS];
 
 extern float interrupt_load;
 
+typedef struct __attribute__((packed)) {
+  uint32_t idle_cycles;              // asleep in idle_sleep(), over the last 1s window
+  uint32_t window_cycles;
+  uint32_t wakeups;
+  uint32_t wake_latency_max_ns;      // timer event to handler, over the last 1s window
+  uint32_t wake_latency_max_all_ns;
+} idle_stats_t;
+
+void idle_sleep(void);
+void idle_record_wake_latency(uint32_t latency_ns);
+void idle_get_stats(idle_stats_t *stats);
+
 void handle_interrupt(IRQn_Type irq_type);
 // Every second
 void interrupt_timer_handler(void);
 void init_interrupts(bool check_rate_limit);
 
-#endif // STM32H7
+#endif // STM32H7 || FDCAN_SIM
 
 // ******************** registers ********************
 
 // 10 bit hash with 23 as a prime
 #define REGISTER_MAP_SIZE 0x3FFU
 #define HASHING_PRIME 23U
+// registers verified per check_registers() call. at 8Hz, a full pass over 256 registers takes 1s
+#define REGISTER_CHECK_SLICE 32U
 
 // Do not put bits in the check mask that get changed by the hardware
 void register_set(volatile uint32_t *addr, uint32_t val, uint32_t mask);
@@ -205,7 +237,7 @@ void register_set_bits(volatile uint32_t *addr, uint32_t val);
 // Clear individual bits. Also add them to the check_mask.
 // Do not use this to clear bits that get set by the hardware
 void register_clear_bits(volatile uint32_t *addr, uint32_t val);
-// To be called periodically
+// To be called periodically, at 8Hz. Checks a slice of the registers per call
 void check_registers(void);
 void init_registers(void);
 
@@ -242,6 +274,7 @@ void spi_tx_done(bool reset);
 
 // ***************************** Definitions *****************************
 #define FIFO_SIZE_INT 0x400U
+#define FIFO_SIZE_SOM_DEBUG_RX 0x4000U  // ~50ms at 3Mbaud
 
 typedef struct uart_ring {
   volatile uint16_t w_ptr_tx;
@@ -255,16 +288,23 @@ typedef struct uart_ring {
   USART_TypeDef *uart;
   void (*callback)(struct uart_ring*);
   bool overwrite;
+  DMA_Stream_TypeDef *dma_rx;  // NULL for the interrupt per byte mode
+  DMA_Stream_TypeDef *dma_tx;
+  volatile uint16_t tx_dma_len;  // in flight from r_ptr_tx
 } uart_ring;
 
 // ***************************** Function prototypes *****************************
 void debug_ring_callback(uart_ring *ring);
 void uart_tx_ring(uart_ring *q);
+void uart_set_baud(uart_ring *q, uint32_t baud);
 uart_ring *get_ring_by_number(int a);
 // ************************* Low-level buffer functions *************************
 bool get_char(uart_ring *q, char *elem);
+uint16_t get_chars(uart_ring *q, uint8_t *buf, uint16_t max_len);
 bool injectc(uart_ring *q, char elem);
 bool put_char(uart_ring *q, char elem);
+uint32_t tx_space(const uart_ring *q);
+uint32_t put_chars(uart_ring *q, const uint8_t *elems, uint32_t len);
 void clear_uart_buff(uart_ring *q);
 // ************************ High-level debug functions **********************
 void putch(const char a);
@@ -285,3 +325,4 @@ static void hexdump(const void *a, int l);
 void usb_init(void);
 void refresh_can_tx_slots_available(void);
 void can_tx_comms_resume_usb(void);
+void comms_endpoint2_resume_usb(void);
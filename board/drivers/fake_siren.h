@@ -2,6 +2,12 @@
 
 #define CODEC_I2C_ADDR 0x10
 
+static i2c_bus_t codec_i2c = {.I2C = I2C5};
+
+static void I2C5_IRQ_Handler(void) {
+  i2c_irq_handler(&codec_i2c);
+}
+
 void siren_tim7_init(void) {
   // Init trigger timer (around 2.5kHz)
   register_set(&TIM7->PSC, 0U, 0xFFFFU);
@@ -33,27 +39,35 @@ void siren_dma_init(void) {
   DMA1_Stream1->CR = (0b11UL << DMA_SxCR_PL_Pos) | DMA_SxCR_MINC | DMA_SxCR_CIRC | (1U << DMA_SxCR_DIR_Pos);
 }
 
+static void fake_siren_codec_failed(void) {
+  print("Siren codec enable failed\n");
+  fault_occurred(FAULT_SIREN_MALFUNCTION);
+}
+
+static void fake_siren_codec_done(bool success, uint8_t value) {
+  UNUSED(value);
+  if (!success) {
+    fake_siren_codec_failed();
+  }
+}
+
+// queued on the codec I2C, returns right away
 void fake_siren_codec_enable(bool enabled) {
   if (enabled) {
     bool success = true;
-    success &= i2c_set_reg_bits(I2C5, CODEC_I2C_ADDR, 0x2B, (1U << 1)); // Left speaker mix from INA1
-    success &= i2c_set_reg_bits(I2C5, CODEC_I2C_ADDR, 0x2C, (1U << 1)); // Right speaker mix from INA1
-    success &= i2c_set_reg_mask(I2C5, CODEC_I2C_ADDR, 0x3D, 0x17, 0b11111); // Left speaker volume
-    success &= i2c_set_reg_mask(I2C5, CODEC_I2C_ADDR, 0x3E, 0x17, 0b11111); // Right speaker volume
-    success &= i2c_set_reg_mask(I2C5, CODEC_I2C_ADDR, 0x37, 0b101, 0b111); // INA gain
-    success &= i2c_set_reg_bits(I2C5, CODEC_I2C_ADDR, 0x4C, (1U << 7)); // Enable INA
-    success &= i2c_set_reg_bits(I2C5, CODEC_I2C_ADDR, 0x51, (1U << 7)); // Disable global shutdown
+    success &= i2c_set_reg_bits(&codec_i2c, CODEC_I2C_ADDR, 0x2B, (1U << 1), fake_siren_codec_done); // Left speaker mix from INA1
+    success &= i2c_set_reg_bits(&codec_i2c, CODEC_I2C_ADDR, 0x2C, (1U << 1), fake_siren_codec_done); // Right speaker mix from INA1
+    success &= i2c_set_reg_mask(&codec_i2c, CODEC_I2C_ADDR, 0x3D, 0x17, 0b11111, fake_siren_codec_done); // Left speaker volume
+    success &= i2c_set_reg_mask(&codec_i2c, CODEC_I2C_ADDR, 0x3E, 0x17, 0b11111, fake_siren_codec_done); // Right speaker volume
+    success &= i2c_set_reg_mask(&codec_i2c, CODEC_I2C_ADDR, 0x37, 0b101, 0b111, fake_siren_codec_done); // INA gain
+    success &= i2c_set_reg_bits(&codec_i2c, CODEC_I2C_ADDR, 0x4C, (1U << 7), fake_siren_codec_done); // Enable INA
+    success &= i2c_set_reg_bits(&codec_i2c, CODEC_I2C_ADDR, 0x51, (1U << 7), fake_siren_codec_done); // Disable global shutdown
     if (!success) {
-      print("Siren codec enable failed\n");
-      fault_occurred(FAULT_SIREN_MALFUNCTION);
+      fake_siren_codec_failed();
     }
   } else {
-    // Disable INA input. Make sure to retry a few times if the I2C bus is busy.
-    for (uint8_t i=0U; i<10U; i++) {
-      if (i2c_clear_reg_bits(I2C5, CODEC_I2C_ADDR, 0x4C, (1U << 7))) {
-        break;
-      }
-    }
+    // Disable INA input. The I2C driver retries if the bus is busy.
+    (void)i2c_clear_reg_bits(&codec_i2c, CODEC_I2C_ADDR, 0x4C, (1U << 7), NULL);
   }
 }
 
@@ -62,7 +76,11 @@ static void fake_i2c_siren_init(void) {
   siren_dma_init();
   siren_tim7_init();
   // Enable the I2C to the codec
-  i2c_init(I2C5);
+  REGISTER_INTERRUPT(I2C5_EV_IRQn, I2C5_IRQ_Handler, I2C_IRQ_RATE, FAULT_SIREN_MALFUNCTION)
+  REGISTER_INTERRUPT(I2C5_ER_IRQn, I2C5_IRQ_Handler, I2C_IRQ_RATE, FAULT_SIREN_MALFUNCTION)
+  i2c_init(&codec_i2c);
+  NVIC_EnableIRQ(I2C5_EV_IRQn);
+  NVIC_EnableIRQ(I2C5_ER_IRQn);
   fake_siren_codec_enable(false);
 }
 
@@ -74,6 +92,7 @@ void fake_i2c_siren_set(bool enabled) {
     fake_i2c_siren_init();
     initialized = true;
   }
+  i2c_tick(&codec_i2c);
 
   if (enabled != fake_siren_enabled) {
     fake_siren_codec_enable(enabled);
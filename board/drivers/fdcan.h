@@ -2,12 +2,27 @@
 
 FDCAN_GlobalTypeDef *cans[PANDA_CAN_CNT] = {FDCAN1, FDCAN2, FDCAN3};
 
-static bool can_set_speed(uint8_t can_number) {
-  bool ret = true;
+can_init_stats_t can_init_stats[PANDA_CAN_CNT];
+
+// (Re)initializing a core is a state machine per core rather than a blocking loop,
+// so a bitrate change or core reset on one bus doesn't stall the CPU or the other
+// busses. It steps on request, then every CAN_INIT_POLL_US from CAN_INIT_TIMER until
+// the core is back on the bus. The tick is the backstop and gives up on stuck cores.
+#define CAN_INIT_IDLE 0U
+#define CAN_INIT_ENTER 1U  // waiting for the core to enter init mode
+#define CAN_INIT_EXIT 2U   // configured, waiting for the core to leave init mode
+#define CAN_INIT_FAULT 3U  // timed out, IRQs stay off until the next can_init()
+#define CAN_INIT_SPIN 64U  // register polls per step, usually enough to finish on request
+#define CAN_INIT_POLL_US 200U
+
+static uint8_t can_init_state[PANDA_CAN_CNT] = {CAN_INIT_IDLE, CAN_INIT_IDLE, CAN_INIT_IDLE};
+static uint32_t can_init_start_ts[PANDA_CAN_CNT];
+
+static void can_set_speed(uint8_t can_number) {
   FDCAN_GlobalTypeDef *FDCANx = CANIF_FROM_CAN_NUM(can_number);
   uint8_t bus_number = BUS_NUM_FROM_CAN_NUM(can_number);
 
-  ret &= llcan_set_speed(
+  llcan_set_speed(
     FDCANx,
     bus_config[bus_number].can_speed,
     bus_config[bus_number].can_data_speed,
@@ -15,18 +30,105 @@ static bool can_set_speed(uint8_t can_number) {
     can_loopback,
     can_silent
   );
+}
+
+static void can_init_done(uint8_t can_number) {
+  uint32_t time = get_ts_elapsed(microsecond_timer_get(), can_init_start_ts[can_number]);
+  can_init_state[can_number] = CAN_INIT_IDLE;
+  can_init_stats[can_number].busy = 0U;
+  can_init_stats[can_number].last_time_us = time;
+  can_init_stats[can_number].max_time_us = MAX(can_init_stats[can_number].max_time_us, time);
+  can_init_stats[can_number].faulted = 0U;
+  llcan_irq_enable(CANIF_FROM_CAN_NUM(can_number));
+}
+
+// the core never made it back, keep it quiet instead of enabling IRQs on a half configured core
+static void can_init_fail(uint8_t can_number) {
+  llcan_irq_disable(CANIF_FROM_CAN_NUM(can_number));
+  can_init_state[can_number] = CAN_INIT_FAULT;
+  can_init_stats[can_number].busy = 0U;
+  can_init_stats[can_number].timeout_cnt += 1U;
+  can_init_stats[can_number].faulted = 1U;
+}
+
+// returns true once the core is back on the bus
+static bool can_init_step(uint8_t can_number) {
+  FDCAN_GlobalTypeDef *FDCANx = CANIF_FROM_CAN_NUM(can_number);
+
+  ENTER_CRITICAL();
+  for (uint32_t i = 0U; (i < CAN_INIT_SPIN) && ((can_init_state[can_number] == CAN_INIT_ENTER) || (can_init_state[can_number] == CAN_INIT_EXIT)); i++) {
+    if (can_init_state[can_number] == CAN_INIT_ENTER) {
+      if (llcan_enter_init(FDCANx)) {
+        can_set_speed(can_number);
+        llcan_init(FDCANx);
+        can_init_state[can_number] = CAN_INIT_EXIT;
+      }
+    } else {
+      if (llcan_exit_init(FDCANx)) {
+        can_init_done(can_number);
+      }
+    }
+  }
+  bool ret = (can_init_state[can_number] == CAN_INIT_IDLE);
+  if (ret) {
+    // in case there are queued up messages. pended rather than called, can_init() runs from within the CAN IRQs
+    llcan_irq_pend_tx(FDCANx);
+  }
+  EXIT_CRITICAL();
+
   return ret;
 }
 
+// steps the cores that are still (re)initializing, returns true if any is left
+static bool can_init_service(bool tick) {
+  bool pending = false;
+  for (uint8_t i = 0U; i < PANDA_CAN_CNT; i++) {
+    if ((can_init_state[i] != CAN_INIT_IDLE) && (can_init_state[i] != CAN_INIT_FAULT) && !can_init_step(i)) {
+      if (tick && (get_ts_elapsed(microsecond_timer_get(), can_init_start_ts[i]) > (CAN_INIT_TIMEOUT_MS * 1000U))) {
+        print(CAN_NAME_FROM_CANIF(CANIF_FROM_CAN_NUM(i))); print(" init timed out!\n");
+        can_init_fail(i);
+      } else {
+        pending = true;
+      }
+    }
+  }
+  return pending;
+}
+
+static void can_init_poll_arm(void) {
+  CAN_INIT_TIMER->CCR1 = CAN_INIT_TIMER->CNT + CAN_INIT_POLL_US;
+  CAN_INIT_TIMER->SR = ~TIM_SR_CC1IF;
+  CAN_INIT_TIMER->DIER |= TIM_DIER_CC1IE;
+}
+
+static void can_init_poll_handler(void) {
+  ENTER_CRITICAL();
+  CAN_INIT_TIMER->SR = ~TIM_SR_CC1IF;
+  if (can_init_service(false)) {
+    can_init_poll_arm();
+  } else {
+    CAN_INIT_TIMER->DIER &= ~TIM_DIER_CC1IE;
+  }
+  EXIT_CRITICAL();
+}
+
+// called from the tick, gives up on stuck cores
+void can_init_tick(void) {
+  (void)can_init_service(true);
+}
+
 void can_clear_send(FDCAN_GlobalTypeDef *FDCANx, uint8_t can_number) {
   static uint32_t last_reset = 0U;
   uint32_t time = microsecond_timer_get();
 
-  // Resetting CAN core is a slow blocking operation, limit frequency
+  // Resetting CAN core takes the core off the bus, limit frequency
   if (get_ts_elapsed(time, last_reset) > 100000U) {  // 10 Hz
     can_health[can_number].can_core_reset_cnt += 1U;
     can_health[can_number].total_tx_lost_cnt += (FDCAN_TX_FIFO_EL_CNT - (FDCANx->TXFQS & FDCAN_TXFQS_TFFL)); // TX FIFO msgs will be lost after reset
-    llcan_clear_send(FDCANx);
+    // from datasheet: "Transmit cancellation is not intended for Tx FIFO operation."
+    // so we need to clear pending transmission manually by resetting FDCAN core
+    FDCANx->IR |= 0x3FCFFFFFU; // clear all interrupts
+    (void)can_init(can_number);
     last_reset = time;
   }
 }
@@ -84,11 +186,14 @@ void update_can_health_pkt(uint8_t can_number, uint32_t ir_reg) {
 // ***************************** CAN *****************************
 // FDFDCANx_IT1 IRQ Handler (TX)
 void process_can(uint8_t can_number) {
-  if (can_number != 0xffU) {
+  PROBE_BEGIN(PROBE_PROCESS_CAN);
+  // the core can't take a frame while it's being (re)initialized, can_init_step() pends us when it's done
+  if ((can_number != 0xffU) && (can_init_state[can_number] == CAN_INIT_IDLE)) {
     ENTER_CRITICAL();
 
     FDCAN_GlobalTypeDef *FDCANx = CANIF_FROM_CAN_NUM(can_number);
     uint8_t bus_number = BUS_NUM_FROM_CAN_NUM(can_number);
+    TRACE(TRACE_PROCESS_CAN, bus_number, can_slots_empty(can_queues[bus_number]));
 
     FDCANx->IR |= FDCAN_IR_TFE; // Clear Tx FIFO Empty flag
 
@@ -143,17 +248,21 @@ void process_can(uint8_t can_number) {
         refresh_can_tx_slots_available();
       }
     }
+    TRACE(TRACE_PROCESS_CAN | TRACE_END, bus_number, can_slots_empty(can_queues[bus_number]));
     EXIT_CRITICAL();
   }
+  PROBE_END(PROBE_PROCESS_CAN);
 }
 
 // FDFDCANx_IT0 IRQ Handler (RX and errors)
 // blink blue when we are receiving CAN messages
 void can_rx(uint8_t can_number) {
+  PROBE_BEGIN(PROBE_CAN_RX);
   FDCAN_GlobalTypeDef *FDCANx = CANIF_FROM_CAN_NUM(can_number);
   uint8_t bus_number = BUS_NUM_FROM_CAN_NUM(can_number);
 
   uint32_t ir_reg = FDCANx->IR;
+  TRACE(TRACE_CAN_RX, bus_number, FDCANx->RXF0S & FDCAN_RXF0S_F0FL);
 
   // Clear all new messages from Rx FIFO 0
   FDCANx->IR |= FDCAN_IR_RF0N;
@@ -219,11 +328,14 @@ void can_rx(uint8_t can_number) {
     body_can_rx(&to_push);
     #endif
 
+    PROBE_BEGIN(PROBE_SAFETY_RX);
     safety_rx_invalid += safety_rx_hook(&to_push) ? 0U : 1U;
+    PROBE_END(PROBE_SAFETY_RX);
     ignition_can_hook(&to_push);
 
     led_set(LED_BLUE, true);
     rx_buffer_overflow += can_push(&can_rx_q, &to_push) ? 0U : 1U;
+    boot_profile_rx();
 
     // Enable CAN FD and BRS if CAN FD message was received
     if (!(bus_config[can_number].canfd_enabled) && (canfd_frame)) {
@@ -241,6 +353,8 @@ void can_rx(uint8_t can_number) {
   if ((ir_reg & (FDCAN_IR_PED | FDCAN_IR_PEA | FDCAN_IR_EP | FDCAN_IR_BO | FDCAN_IR_RF0L)) != 0U) {
     update_can_health_pkt(can_number, ir_reg);
   }
+  TRACE(TRACE_CAN_RX | TRACE_END, bus_number, can_slots_empty(&can_rx_q));
+  PROBE_END(PROBE_CAN_RX);
 }
 
 static void FDCAN1_IT0_IRQ_Handler(void) { can_rx(0); }
@@ -261,13 +375,20 @@ bool can_init(uint8_t can_number) {
   REGISTER_INTERRUPT(FDCAN2_IT1_IRQn, FDCAN2_IT1_IRQ_Handler, CAN_INTERRUPT_RATE, FAULT_INTERRUPT_RATE_CAN_2)
   REGISTER_INTERRUPT(FDCAN3_IT0_IRQn, FDCAN3_IT0_IRQ_Handler, CAN_INTERRUPT_RATE, FAULT_INTERRUPT_RATE_CAN_3)
   REGISTER_INTERRUPT(FDCAN3_IT1_IRQn, FDCAN3_IT1_IRQ_Handler, CAN_INTERRUPT_RATE, FAULT_INTERRUPT_RATE_CAN_3)
+  REGISTER_INTERRUPT(CAN_INIT_TIMER_IRQ, can_init_poll_handler, (1000000U / CAN_INIT_POLL_US) + 100U, FAULT_INTERRUPT_RATE_TICK)
+  NVIC_EnableIRQ(CAN_INIT_TIMER_IRQ);
 
   if (can_number != 0xffU) {
-    FDCAN_GlobalTypeDef *FDCANx = CANIF_FROM_CAN_NUM(can_number);
-    ret &= can_set_speed(can_number);
-    ret &= llcan_init(FDCANx);
-    // in case there are queued up messages
-    process_can(can_number);
+    ENTER_CRITICAL();
+    can_init_state[can_number] = CAN_INIT_ENTER;
+    can_init_start_ts[can_number] = microsecond_timer_get();
+    can_init_stats[can_number].busy = 1U;
+    can_init_stats[can_number].cnt += 1U;
+    ret = can_init_step(can_number);
+    if (!ret) {
+      can_init_poll_arm();
+    }
+    EXIT_CRITICAL();
   }
   return ret;
 }
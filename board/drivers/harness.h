@@ -2,6 +2,100 @@
 
 struct harness_t harness;
 
+// The SBU pins are switched to analog for the orientation measurement only until the ADC scan has
+// converted them once, harness_measure_done() runs from the scan's DMA interrupt then.
+// harness.sbu_seq is odd while they are, the ignition line can't be read then.
+
+static bool harness_read_ignition(void) {
+  bool ret = false;
+  switch(harness.status){
+    case HARNESS_STATUS_NORMAL:
+      ret = !get_gpio_input(current_board->harness_config->GPIO_SBU1, current_board->harness_config->pin_SBU1);
+      break;
+    case HARNESS_STATUS_FLIPPED:
+      ret = !get_gpio_input(current_board->harness_config->GPIO_SBU2, current_board->harness_config->pin_SBU2);
+      break;
+    default:
+      break;
+  }
+  return ret;
+}
+
+// call in a critical section
+static void harness_sbu_input(void) {
+  // Pins are not 5V tolerant in ADC mode
+  set_gpio_mode(current_board->harness_config->GPIO_SBU1, current_board->harness_config->pin_SBU1, MODE_INPUT);
+  set_gpio_mode(current_board->harness_config->GPIO_SBU2, current_board->harness_config->pin_SBU2, MODE_INPUT);
+  harness.sbu_seq++;
+  harness.sbu_measure_max_us = MAX(harness.sbu_measure_max_us, get_ts_elapsed(microsecond_timer_get(), harness.sbu_measure_start));
+}
+
+static uint8_t harness_detect(uint16_t sbu1_voltage_mV, uint16_t sbu2_voltage_mV) {
+  uint8_t ret;
+  uint16_t detection_threshold = current_board->avdd_mV / 2U;
+
+  // Detect connection and orientation
+  if((sbu1_voltage_mV < detection_threshold) || (sbu2_voltage_mV < detection_threshold)){
+    if (sbu1_voltage_mV < sbu2_voltage_mV) {
+      // orientation flipped (PANDA_SBU1->HARNESS_SBU1(relay), PANDA_SBU2->HARNESS_SBU2(ign))
+      ret = HARNESS_STATUS_FLIPPED;
+    } else {
+      // orientation normal (PANDA_SBU2->HARNESS_SBU1(relay), PANDA_SBU1->HARNESS_SBU2(ign))
+      // (SBU1->SBU2 is the normal orientation connection per USB-C cable spec)
+      ret = HARNESS_STATUS_NORMAL;
+    }
+  } else {
+    ret = HARNESS_STATUS_NC;
+  }
+
+  return ret;
+}
+
+// Returns false if the relay is driven or the last measurement hasn't finished
+static bool harness_measure_start(void) {
+  ENTER_CRITICAL();
+  bool start = !harness.relay_driven && !harness.sbu_scanning;
+  if (start) {
+    harness.ignition = harness_read_ignition();
+    harness.sbu_seq++;
+    harness.sbu_scanning = true;
+    harness.sbu_measure_start = microsecond_timer_get();
+    set_gpio_mode(current_board->harness_config->GPIO_SBU1, current_board->harness_config->pin_SBU1, MODE_ANALOG);
+    set_gpio_mode(current_board->harness_config->GPIO_SBU2, current_board->harness_config->pin_SBU2, MODE_ANALOG);
+  }
+  EXIT_CRITICAL();
+
+  if (start) {
+    (void)adc_scan_add(&current_board->harness_config->adc_signal_SBU1);
+    (void)adc_scan_add(&current_board->harness_config->adc_signal_SBU2);
+  }
+  return start;
+}
+
+static void harness_measure_done(void) {
+  // the SBU channels are last in the scan, the next pass doesn't get to them before they're read
+  uint16_t sbu1_voltage_mV = adc_get_mV(&current_board->harness_config->adc_signal_SBU1);
+  uint16_t sbu2_voltage_mV = adc_get_mV(&current_board->harness_config->adc_signal_SBU2);
+
+  // set_intercept_relay() may have dropped the measurement already
+  ENTER_CRITICAL();
+  bool measured = (harness.sbu_seq & 1U) != 0U;
+  if (measured) {
+    harness_sbu_input();
+  }
+  EXIT_CRITICAL();
+
+  adc_scan_remove(&current_board->harness_config->adc_signal_SBU1);
+  adc_scan_remove(&current_board->harness_config->adc_signal_SBU2);
+
+  if (measured) {
+    harness.sbu1_voltage_mV = sbu1_voltage_mV;
+    harness.sbu2_voltage_mV = sbu2_voltage_mV;
+    harness.status = harness_detect(sbu1_voltage_mV, sbu2_voltage_mV);
+  }
+  harness.sbu_scanning = false;
+}
+
 // The ignition relay is only used for testing purposes
 void set_intercept_relay(bool intercept, bool ignition_relay) {
   bool drive_relay = intercept;
@@ -10,12 +104,16 @@ void set_intercept_relay(bool intercept, bool ignition_relay) {
     drive_relay = false;
   }
 
+  ENTER_CRITICAL();
   if (drive_relay || ignition_relay) {
     harness.relay_driven = true;
-  }
 
-  // wait until we're not reading the analog voltages anymore
-  while (harness.sbu_adc_lock) {}
+    // drop a measurement in progress, the pins have to be back in input mode first.
+    // The scan still lets go of the channels in harness_measure_done().
+    if ((harness.sbu_seq & 1U) != 0U) {
+      harness_sbu_input();
+    }
+  }
 
   if (harness.status == HARNESS_STATUS_NORMAL) {
     set_gpio_output(current_board->harness_config->GPIO_relay_SBU1, current_board->harness_config->pin_relay_SBU1, !ignition_relay);
@@ -28,67 +126,26 @@ void set_intercept_relay(bool intercept, bool ignition_relay) {
   if (!(drive_relay || ignition_relay)) {
     harness.relay_driven = false;
   }
+  EXIT_CRITICAL();
 }
 
 bool harness_check_ignition(void) {
-  bool ret = false;
-
-  // wait until we're not reading the analog voltages anymore
-  while (harness.sbu_adc_lock) {}
-
-  switch(harness.status){
-    case HARNESS_STATUS_NORMAL:
-      ret = !get_gpio_input(current_board->harness_config->GPIO_SBU1, current_board->harness_config->pin_SBU1);
-      break;
-    case HARNESS_STATUS_FLIPPED:
-      ret = !get_gpio_input(current_board->harness_config->GPIO_SBU2, current_board->harness_config->pin_SBU2);
-      break;
-    default:
-      break;
+  // the pins read low in analog mode, use the last reading from before the measurement then
+  uint32_t seq = harness.sbu_seq;
+  bool ret = harness_read_ignition();
+  if (((seq & 1U) != 0U) || (seq != harness.sbu_seq)) {
+    ret = harness.ignition;
   }
   return ret;
 }
 
-static uint8_t harness_detect_orientation(void) {
-  uint8_t ret = harness.status;
-
+void harness_tick(void) {
   #ifndef BOOTSTUB
   // We can't detect orientation if the relay is being driven
-  if (!harness.relay_driven) {
-    harness.sbu_adc_lock = true;
-    set_gpio_mode(current_board->harness_config->GPIO_SBU1, current_board->harness_config->pin_SBU1, MODE_ANALOG);
-    set_gpio_mode(current_board->harness_config->GPIO_SBU2, current_board->harness_config->pin_SBU2, MODE_ANALOG);
-
-    harness.sbu1_voltage_mV = adc_get_mV(&current_board->harness_config->adc_signal_SBU1);
-    harness.sbu2_voltage_mV = adc_get_mV(&current_board->harness_config->adc_signal_SBU2);
-    uint16_t detection_threshold = current_board->avdd_mV / 2U;
-
-    // Detect connection and orientation
-    if((harness.sbu1_voltage_mV < detection_threshold) || (harness.sbu2_voltage_mV < detection_threshold)){
-      if (harness.sbu1_voltage_mV < harness.sbu2_voltage_mV) {
-        // orientation flipped (PANDA_SBU1->HARNESS_SBU1(relay), PANDA_SBU2->HARNESS_SBU2(ign))
-        ret = HARNESS_STATUS_FLIPPED;
-      } else {
-        // orientation normal (PANDA_SBU2->HARNESS_SBU1(relay), PANDA_SBU1->HARNESS_SBU2(ign))
-        // (SBU1->SBU2 is the normal orientation connection per USB-C cable spec)
-        ret = HARNESS_STATUS_NORMAL;
-      }
-    } else {
-      ret = HARNESS_STATUS_NC;
-    }
-
-    // Pins are not 5V tolerant in ADC mode
-    set_gpio_mode(current_board->harness_config->GPIO_SBU1, current_board->harness_config->pin_SBU1, MODE_INPUT);
-    set_gpio_mode(current_board->harness_config->GPIO_SBU2, current_board->harness_config->pin_SBU2, MODE_INPUT);
-    harness.sbu_adc_lock = false;
+  if (harness_measure_start()) {
+    adc_scan_notify(current_board->harness_config->adc_signal_SBU1.adc, harness_measure_done);
   }
   #endif
-
-  return ret;
-}
-
-void harness_tick(void) {
-  harness.status = harness_detect_orientation();
 }
 
 void harness_init(void) {
@@ -99,7 +156,13 @@ void harness_init(void) {
   set_gpio_output(current_board->harness_config->GPIO_relay_SBU2, current_board->harness_config->pin_relay_SBU2, 1);
 
   // detect initial orientation
-  harness.status = harness_detect_orientation();
+  #ifndef BOOTSTUB
+  // interrupts are still off, wait for the scan here
+  (void)harness_measure_start();
+  uint32_t start = microsecond_timer_get();
+  while (!adc_scan_ready(current_board->harness_config->adc_signal_SBU1.adc) && (get_ts_elapsed(microsecond_timer_get(), start) < 100000U)) {}
+  harness_measure_done();
+  #endif
 
   // keep buses connected by default
   set_intercept_relay(false, false);
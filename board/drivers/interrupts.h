@@ -14,6 +14,13 @@ static uint32_t idle_time = 0U;
 static uint32_t busy_time = 0U;
 float interrupt_load = 0.0f;
 
+// main loop sleep accounting, rolled over into idle_stats by the interrupt timer
+static uint32_t idle_cycles = 0U;
+static uint32_t idle_wakeups = 0U;
+static uint32_t idle_window_start = 0U;
+static uint32_t wake_latency_max_ns = 0U;
+static idle_stats_t idle_stats;
+
 void handle_interrupt(IRQn_Type irq_type){
   static uint8_t interrupt_depth = 0U;
   static uint32_t last_time = 0U;
@@ -44,6 +51,31 @@ void handle_interrupt(IRQn_Type irq_type){
   EXIT_CRITICAL();
 }
 
+// Sleeps until the next interrupt at full clock. IRQs stay masked across the WFI, a pending
+// interrupt still wakes the core, so the time asleep is taken before its handler runs.
+void idle_sleep(void) {
+  ENTER_CRITICAL();
+  uint32_t start = DWT->CYCCNT;
+  __WFI();
+  idle_cycles += DWT->CYCCNT - start;
+  idle_wakeups += 1U;
+  EXIT_CRITICAL();
+}
+
+// called from a timer interrupt with the time since its update event
+void idle_record_wake_latency(uint32_t latency_ns) {
+  ENTER_CRITICAL();
+  wake_latency_max_ns = MAX(wake_latency_max_ns, latency_ns);
+  idle_stats.wake_latency_max_all_ns = MAX(idle_stats.wake_latency_max_all_ns, latency_ns);
+  EXIT_CRITICAL();
+}
+
+void idle_get_stats(idle_stats_t *stats) {
+  ENTER_CRITICAL();
+  *stats = idle_stats;
+  EXIT_CRITICAL();
+}
+
 // Every second
 void interrupt_timer_handler(void) {
   if (INTERRUPT_TIMER->SR != 0U) {
@@ -65,6 +97,18 @@ void interrupt_timer_handler(void) {
 #endif
     idle_time = 0U;
     busy_time = 0U;
+
+    ENTER_CRITICAL();
+    uint32_t now = DWT->CYCCNT;
+    idle_stats.idle_cycles = idle_cycles;
+    idle_stats.window_cycles = now - idle_window_start;
+    idle_stats.wakeups = idle_wakeups;
+    idle_stats.wake_latency_max_ns = wake_latency_max_ns;
+    idle_window_start = now;
+    idle_cycles = 0U;
+    idle_wakeups = 0U;
+    wake_latency_max_ns = 0U;
+    EXIT_CRITICAL();
   }
   INTERRUPT_TIMER->SR = 0;
 }
@@ -30,3 +30,76 @@ void led_init(void) {
     led_set(i, false);
   }
 }
+
+#ifndef BOOTSTUB
+// Red LED fade while not power saving, as a heartbeat. LED_FADE_TIMER steps the brightness and,
+// for boards without PWM on the red LED, also does the PWM: on at the update, off at compare 1.
+// The timer counts since its update event, so its handler also samples the interrupt latency.
+#define LED_FADE_TICK_NS 100U      // 10MHz
+#define LED_FADE_PERIOD 50000U     // 5ms steps
+#define LED_FADE_STEPS 200U        // 1s up, 1s down
+
+static bool led_fade_enabled = false;
+static uint16_t led_fade_step = 0U;
+
+static bool led_fade_soft_pwm(void) {
+  return current_board->led_pwm_channels[LED_RED] == 0U;
+}
+
+static void led_fade_irq_handler(void) {
+  uint32_t latency = LED_FADE_TIMER->CNT;
+  uint32_t sr = LED_FADE_TIMER->SR;
+  LED_FADE_TIMER->SR = ~sr;
+
+  // compare before update: a pending compare is from the period that just ended
+  if ((sr & TIM_SR_CC1IF) != 0U) {
+    led_set(LED_RED, false);
+  }
+
+  if ((sr & TIM_SR_UIF) != 0U) {
+    idle_record_wake_latency(latency * LED_FADE_TICK_NS);
+
+    led_fade_step = (led_fade_step + 1U) % (2U * LED_FADE_STEPS);
+    uint16_t level = (led_fade_step < LED_FADE_STEPS) ? led_fade_step : (uint16_t)((2U * LED_FADE_STEPS) - led_fade_step);
+    #ifdef DEBUG_FAULTS
+    if (fault_status != FAULT_STATUS_NONE) {
+      level = (led_fade_step < LED_FADE_STEPS) ? LED_FADE_STEPS : 0U;
+    }
+    #endif
+
+    if (led_fade_soft_pwm()) {
+      register_set(&(LED_FADE_TIMER->CCR1), (LED_FADE_PERIOD * level) / LED_FADE_STEPS, 0xFFFFU);
+      if (level != 0U) {
+        led_set(LED_RED, true);
+      }
+    } else {
+      // same range as led_set(), active low
+      pwm_set_fraction(TIM3, current_board->led_pwm_channels[LED_RED], (100U * LED_FADE_STEPS) - (LED_PWM_POWER * level), 100U * LED_FADE_STEPS);
+    }
+  }
+}
+
+void led_fade_enable(bool enabled) {
+  if (enabled != led_fade_enabled) {
+    ENTER_CRITICAL();
+    led_fade_enabled = enabled;
+    register_set(&(LED_FADE_TIMER->CR1), (enabled ? TIM_CR1_CEN : 0U), TIM_CR1_CEN);
+    LED_FADE_TIMER->SR = 0U;
+    NVIC_ClearPendingIRQ(LED_FADE_TIMER_IRQ);
+    led_set(LED_RED, false);
+    EXIT_CRITICAL();
+  }
+}
+
+void led_fade_init(void) {
+  register_set(&(LED_FADE_TIMER->PSC), ((APB1_TIMER_FREQ / 10U) - 1U), 0xFFFFU);
+  register_set(&(LED_FADE_TIMER->ARR), (LED_FADE_PERIOD - 1U), 0xFFFFU);
+  register_set(&(LED_FADE_TIMER->DIER), (TIM_DIER_UIE | (led_fade_soft_pwm() ? TIM_DIER_CC1IE : 0U)), 0x5F5FU);
+  LED_FADE_TIMER->EGR = TIM_EGR_UG;
+  LED_FADE_TIMER->SR = 0U;
+
+  // 200Hz, twice that with the software PWM
+  REGISTER_INTERRUPT(LED_FADE_TIMER_IRQ, led_fade_irq_handler, 500U, FAULT_INTERRUPT_RATE_TICK)
+  NVIC_EnableIRQ(LED_FADE_TIMER_IRQ);
+}
+#endif
@@ -35,8 +35,9 @@ void pwm_init(TIM_TypeDef *TIM, uint8_t channel){
   TIM->EGR |= TIM_EGR_UG;
 }
 
-void pwm_set(TIM_TypeDef *TIM, uint8_t channel, uint8_t percentage){
-  uint16_t comp_value = (((uint16_t) percentage * PWM_COUNTER_OVERFLOW) / 100U);
+// duty cycle of num / den, for finer steps than pwm_set()
+void pwm_set_fraction(TIM_TypeDef *TIM, uint8_t channel, uint32_t num, uint32_t den){
+  uint16_t comp_value = (uint16_t)((num * PWM_COUNTER_OVERFLOW) / den);
   switch(channel){
     case 1U:
       register_set(&(TIM->CCR1), comp_value, 0xFFFFU);
@@ -54,3 +55,7 @@ void pwm_set(TIM_TypeDef *TIM, uint8_t channel, uint8_t percentage){
       break;
   }
 }
+
+void pwm_set(TIM_TypeDef *TIM, uint8_t channel, uint8_t percentage){
+  pwm_set_fraction(TIM, channel, percentage, 100U);
+}
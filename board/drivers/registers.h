@@ -11,6 +11,11 @@ typedef struct reg {
 
 static reg register_map[REGISTER_MAP_SIZE];
 
+// slots in use, in insertion order, so the checker doesn't walk the empty part of the map
+static uint16_t register_list[REGISTER_MAP_SIZE];
+static uint16_t register_list_len = 0U;
+static uint16_t register_check_idx = 0U;
+
 // Hash spread in first and second iterations seems to be reasonable.
 // See: tests/development/register_hashmap_spread.py
 // Also, check the collision warnings in the debug output, and minimize those.
@@ -29,6 +34,10 @@ void register_set(volatile uint32_t *addr, uint32_t val, uint32_t mask){
   uint16_t tries = REGISTER_MAP_SIZE;
   while(CHECK_COLLISION(hash, addr) && (tries > 0U)) { hash = hash_addr((uint32_t) hash); tries--;}
   if (tries != 0U){
+    if ((uint32_t) register_map[hash].address == 0U) {
+      register_list[register_list_len] = hash;
+      register_list_len++;
+    }
     register_map[hash].address = addr;
     register_map[hash].value = (register_map[hash].value & (~mask)) | (val & mask);
     register_map[hash].check_mask |= mask;
@@ -52,23 +61,24 @@ void register_clear_bits(volatile uint32_t *addr, uint32_t val) {
   register_set(addr, (~val), val);
 }
 
-// To be called periodically
+// To be called periodically, checks the next REGISTER_CHECK_SLICE registers.
+// A divergent register is found within ceil(registers in use / REGISTER_CHECK_SLICE) calls.
 void check_registers(void){
-  for(uint16_t i=0U; i<REGISTER_MAP_SIZE; i++){
-    if((uint32_t) register_map[i].address != 0U){
-      ENTER_CRITICAL()
-      if((*(register_map[i].address) & register_map[i].check_mask) != (register_map[i].value & register_map[i].check_mask)){
-        #ifdef DEBUG_FAULTS
-          print("Register at address 0x"); puth((uint32_t) register_map[i].address); print(" is divergent!");
-          print("   Map: 0x"); puth(register_map[i].value);
-          print("   Register: 0x"); puth(*(register_map[i].address));
-          print("   Mask: 0x"); puth(register_map[i].check_mask);
-          print("\n");
-        #endif
-        fault_occurred(FAULT_REGISTER_DIVERGENT);
-      }
-      EXIT_CRITICAL()
+  for(uint16_t n=0U; (n<REGISTER_CHECK_SLICE) && (n<register_list_len); n++){
+    ENTER_CRITICAL()
+    register_check_idx = (register_check_idx + 1U) % register_list_len;
+    uint16_t i = register_list[register_check_idx];
+    if((*(register_map[i].address) & register_map[i].check_mask) != (register_map[i].value & register_map[i].check_mask)){
+      #ifdef DEBUG_FAULTS
+        print("Register at address 0x"); puth((uint32_t) register_map[i].address); print(" is divergent!");
+        print("   Map: 0x"); puth(register_map[i].value);
+        print("   Register: 0x"); puth(*(register_map[i].address));
+        print("   Mask: 0x"); puth(register_map[i].check_mask);
+        print("\n");
+      #endif
+      fault_occurred(FAULT_REGISTER_DIVERGENT);
     }
+    EXIT_CRITICAL()
   }
 }
 
@@ -77,4 +87,6 @@ void init_registers(void) {
     register_map[i].address = (volatile uint32_t *) 0U;
     register_map[i].check_mask = 0U;
   }
+  register_list_len = 0U;
+  register_check_idx = 0U;
 }
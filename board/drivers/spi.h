@@ -104,6 +104,7 @@ static bool validate_checksum(const uint8_t *data, uint16_t len) {
 }
 
 void spi_rx_done(void) {
+  PROBE_BEGIN(PROBE_SPI_RX_DONE);
   uint16_t response_len = 0U;
   uint8_t next_rx_state = SPI_STATE_HEADER_NACK;
   bool checksum_valid = false;
@@ -114,6 +115,7 @@ void spi_rx_done(void) {
   spi_endpoint = spi_buf_rx[1];
   spi_data_len_mosi = (spi_buf_rx[3] << 8) | spi_buf_rx[2];
   spi_data_len_miso = (spi_buf_rx[5] << 8) | spi_buf_rx[4];
+  TRACE(TRACE_SPI_RX_DONE, spi_endpoint, spi_data_len_mosi);
 
   if (memcmp(spi_buf_rx, version_text, 7) == 0) {
     response_len = spi_version_packet(spi_buf_tx);
@@ -156,8 +158,8 @@ void spi_rx_done(void) {
           print("SPI: did not expect data for can_read\n");
         }
       } else if (spi_endpoint == 2U) {
-        comms_endpoint2_write(&spi_buf_rx[SPI_HEADER_SIZE], spi_data_len_mosi);
-        response_ack = true;
+        // NACK what doesn't fit, the host retries
+        response_ack = comms_endpoint2_write(&spi_buf_rx[SPI_HEADER_SIZE], spi_data_len_mosi);
       } else if (spi_endpoint == 3U) {
         if (spi_data_len_mosi > 0U) {
           if (spi_can_tx_ready) {
@@ -171,6 +173,22 @@ void spi_rx_done(void) {
         } else {
           print("SPI: did expect data for can_write\n");
         }
+      #ifdef TRACE_ENABLED
+      } else if (spi_endpoint == 4U) {
+        if (spi_data_len_mosi == 0U) {
+          response_len = trace_read(&(spi_buf_tx[3]), spi_data_len_miso);
+          response_ack = true;
+        } else {
+          print("SPI: did not expect data for trace_read\n");
+        }
+      #endif
+      } else if (spi_endpoint == 5U) {
+        if (spi_data_len_mosi == 0U) {
+          response_len = comms_serial_read(&(spi_buf_tx[3]), spi_data_len_miso);
+          response_ack = true;
+        } else {
+          print("SPI: did not expect data for serial_read\n");
+        }
       } else if (spi_endpoint == 0xABU) {
         // test endpoint: mimics panda -> device transfer
         response_len = spi_data_len_miso;
@@ -231,6 +249,8 @@ void spi_rx_done(void) {
   if (!checksum_valid) {
     spi_error_count += 1U;
   }
+  TRACE(TRACE_SPI_RX_DONE | TRACE_END, spi_endpoint, response_len);
+  PROBE_END(PROBE_SPI_RX_DONE);
 }
 
 void spi_tx_done(bool reset) {
@@ -2,9 +2,10 @@
 
 // ***************************** Definitions *****************************
 
+// in AXI SRAM so the rings can be used with DMA
 #define UART_BUFFER(x, size_rx, size_tx, uart_ptr, callback_ptr, overwrite_mode) \
-  static uint8_t elems_rx_##x[size_rx]; \
-  static uint8_t elems_tx_##x[size_tx]; \
+  __attribute__((section(".axisram"))) static uint8_t elems_rx_##x[size_rx]; \
+  __attribute__((section(".axisram"))) static uint8_t elems_tx_##x[size_tx]; \
   extern uart_ring uart_ring_##x; \
   uart_ring uart_ring_##x = {  \
     .w_ptr_tx = 0, \
@@ -26,7 +27,7 @@
 UART_BUFFER(debug, FIFO_SIZE_INT, FIFO_SIZE_INT, USART2, debug_ring_callback, true)
 
 // SOM debug = UART7
-UART_BUFFER(som_debug, FIFO_SIZE_INT, FIFO_SIZE_INT, UART7, NULL, true)
+UART_BUFFER(som_debug, FIFO_SIZE_SOM_DEBUG_RX, FIFO_SIZE_INT, UART7, NULL, true)
 
 uart_ring *get_ring_by_number(int a) {
   uart_ring *ring = NULL;
@@ -59,6 +60,20 @@ bool get_char(uart_ring *q, char *elem) {
   return ret;
 }
 
+// copies out up to max_len bytes in at most two spans. under the lock, since overwrite rings move r_ptr_rx on their own
+uint16_t get_chars(uart_ring *q, uint8_t *buf, uint16_t max_len) {
+  ENTER_CRITICAL();
+  uint16_t used = (uint16_t)((q->w_ptr_rx + q->rx_fifo_size - q->r_ptr_rx) % q->rx_fifo_size);
+  uint16_t len = MIN(used, max_len);
+  uint16_t first = (uint16_t)MIN(len, q->rx_fifo_size - q->r_ptr_rx);
+  (void)memcpy(buf, &q->elems_rx[q->r_ptr_rx], first);
+  (void)memcpy(&buf[first], q->elems_rx, len - first);
+  q->r_ptr_rx = (q->r_ptr_rx + len) % q->rx_fifo_size;
+  EXIT_CRITICAL();
+
+  return len;
+}
+
 bool injectc(uart_ring *q, char elem) {
   int ret = false;
   uint16_t next_w_ptr;
@@ -81,15 +96,12 @@ bool injectc(uart_ring *q, char elem) {
   return ret;
 }
 
-bool put_char(uart_ring *q, char elem) {
+static bool put_char_locked(uart_ring *q, char elem) {
   bool ret = false;
-  uint16_t next_w_ptr;
+  uint16_t next_w_ptr = (q->w_ptr_tx + 1U) % q->tx_fifo_size;
 
-  ENTER_CRITICAL();
-  next_w_ptr = (q->w_ptr_tx + 1U) % q->tx_fifo_size;
-
-  if ((next_w_ptr == q->r_ptr_tx) && q->overwrite) {
-    // overwrite mode: drop oldest byte
+  // overwrite mode: drop oldest byte. not while DMA could be reading it
+  if ((next_w_ptr == q->r_ptr_tx) && q->overwrite && (q->dma_tx == NULL)) {
     q->r_ptr_tx = (q->r_ptr_tx + 1U) % q->tx_fifo_size;
   }
 
@@ -98,6 +110,32 @@ bool put_char(uart_ring *q, char elem) {
     q->w_ptr_tx = next_w_ptr;
     ret = true;
   }
+  return ret;
+}
+
+bool put_char(uart_ring *q, char elem) {
+  ENTER_CRITICAL();
+  bool ret = put_char_locked(q, elem);
+  EXIT_CRITICAL();
+
+  uart_tx_ring(q);
+
+  return ret;
+}
+
+// bytes put_chars() can queue without overwriting
+uint32_t tx_space(const uart_ring *q) {
+  return (q->r_ptr_tx + q->tx_fifo_size - q->w_ptr_tx - 1U) % q->tx_fifo_size;
+}
+
+// returns how many were queued
+uint32_t put_chars(uart_ring *q, const uint8_t *elems, uint32_t len) {
+  uint32_t ret = 0U;
+
+  ENTER_CRITICAL();
+  while ((ret < len) && put_char_locked(q, (char)elems[ret])) {
+    ret++;
+  }
   EXIT_CRITICAL();
 
   uart_tx_ring(q);
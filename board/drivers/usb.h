@@ -89,6 +89,7 @@ static uint8_t response[USBPACKET_MAX_SIZE];
 static USB_Setup_TypeDef setup;
 static uint8_t* ep0_txdata = NULL;
 static uint16_t ep0_txlen = 0;
+static bool outep2_processing = false;
 static bool outep3_processing = false;
 
 // Store the current interface alt setting.
@@ -181,6 +182,14 @@ static void usb_reset(void) {
   // EP1, massive
   USBx->DIEPTXF[0] = (0x40UL << 16) | 0x80U;
 
+  #ifdef TRACE_ENABLED
+  // EP4, event trace
+  USBx->DIEPTXF[3] = (0x40UL << 16) | 0xC0U;
+  #endif
+
+  // EP5, serial read
+  USBx->DIEPTXF[4] = (0x40UL << 16) | 0x100U;
+
   // flush TX fifo
   USBx->GRSTCTL = USB_OTG_GRSTCTL_TXFFLSH | USB_OTG_GRSTCTL_TXFNUM_4;
   while ((USBx->GRSTCTL & USB_OTG_GRSTCTL_TXFFLSH) == USB_OTG_GRSTCTL_TXFFLSH);
@@ -226,12 +235,20 @@ static void usb_setup(void) {
 
   static uint8_t configuration_desc[] = {
     DSCR_CONFIG_LEN, USB_DESC_TYPE_CONFIGURATION, // Length, Type,
-    TOUSBORDER(0x0045U), // Total Len (uint16)
+    #ifdef TRACE_ENABLED
+    TOUSBORDER(0x0061U), // Total Len (uint16)
+    #else
+    TOUSBORDER(0x0053U), // Total Len (uint16)
+    #endif
     0x01, 0x01, STRING_OFFSET_ICONFIGURATION, // Num Interface, Config Value, Configuration
     0xc0, 0x32, // Attributes, Max Power
     // interface 0 ALT 0
     DSCR_INTERFACE_LEN, USB_DESC_TYPE_INTERFACE, // Length, Type
-    0x00, 0x00, 0x03, // Index, Alt Index idx, Endpoint count
+    #ifdef TRACE_ENABLED
+    0x00, 0x00, 0x05, // Index, Alt Index idx, Endpoint count
+    #else
+    0x00, 0x00, 0x04, // Index, Alt Index idx, Endpoint count
+    #endif
     0XFF, 0xFF, 0xFF, // Class, Subclass, Protocol
     0x00, // Interface
       // endpoint 1, read CAN
@@ -249,9 +266,25 @@ static void usb_setup(void) {
       ENDPOINT_SND | 3, ENDPOINT_TYPE_BULK, // Endpoint Num/Direction, Type
       TOUSBORDER(0x0040U), // Max Packet (0x0040)
       0x00, // Polling Interval
+      // endpoint 5, read SOM debug serial
+      DSCR_ENDPOINT_LEN, USB_DESC_TYPE_ENDPOINT, // Length, Type
+      ENDPOINT_RCV | 5, ENDPOINT_TYPE_BULK, // Endpoint Num/Direction, Type
+      TOUSBORDER(0x0040U), // Max Packet (0x0040)
+      0x00, // Polling Interval (NA)
+    #ifdef TRACE_ENABLED
+      // endpoint 4, read event trace
+      DSCR_ENDPOINT_LEN, USB_DESC_TYPE_ENDPOINT, // Length, Type
+      ENDPOINT_RCV | 4, ENDPOINT_TYPE_BULK, // Endpoint Num/Direction, Type
+      TOUSBORDER(0x0040U), // Max Packet (0x0040)
+      0x00, // Polling Interval (NA)
+    #endif
     // interface 0 ALT 1
     DSCR_INTERFACE_LEN, USB_DESC_TYPE_INTERFACE, // Length, Type
-    0x00, 0x01, 0x03, // Index, Alt Index idx, Endpoint count
+    #ifdef TRACE_ENABLED
+    0x00, 0x01, 0x05, // Index, Alt Index idx, Endpoint count
+    #else
+    0x00, 0x01, 0x04, // Index, Alt Index idx, Endpoint count
+    #endif
     0XFF, 0xFF, 0xFF, // Class, Subclass, Protocol
     0x00, // Interface
       // endpoint 1, read CAN
@@ -269,6 +302,18 @@ static void usb_setup(void) {
       ENDPOINT_SND | 3, ENDPOINT_TYPE_BULK, // Endpoint Num/Direction, Type
       TOUSBORDER(0x0040U), // Max Packet (0x0040)
       0x00, // Polling Interval
+      // endpoint 5, read SOM debug serial
+      DSCR_ENDPOINT_LEN, USB_DESC_TYPE_ENDPOINT, // Length, Type
+      ENDPOINT_RCV | 5, ENDPOINT_TYPE_BULK, // Endpoint Num/Direction, Type
+      TOUSBORDER(0x0040U), // Max Packet (0x0040)
+      0x00, // Polling Interval (NA)
+    #ifdef TRACE_ENABLED
+      // endpoint 4, read event trace
+      DSCR_ENDPOINT_LEN, USB_DESC_TYPE_ENDPOINT, // Length, Type
+      ENDPOINT_RCV | 4, ENDPOINT_TYPE_BULK, // Endpoint Num/Direction, Type
+      TOUSBORDER(0x0040U), // Max Packet (0x0040)
+      0x00, // Polling Interval (NA)
+    #endif
   };
 
   // STRING_DESCRIPTOR_HEADER is for uint16 string descriptors
@@ -442,6 +487,16 @@ static void usb_setup(void) {
                               USB_OTG_DIEPCTL_SD0PID_SEVNFRM | USB_OTG_DIEPCTL_USBAEP;
       USBx_INEP(1U)->DIEPINT = 0xFF;
 
+      #ifdef TRACE_ENABLED
+      USBx_INEP(4U)->DIEPCTL = (0x40U & USB_OTG_DIEPCTL_MPSIZ) | (2UL << 18) | (4UL << 22) |
+                              USB_OTG_DIEPCTL_SD0PID_SEVNFRM | USB_OTG_DIEPCTL_USBAEP;
+      USBx_INEP(4U)->DIEPINT = 0xFF;
+      #endif
+
+      USBx_INEP(5U)->DIEPCTL = (0x40U & USB_OTG_DIEPCTL_MPSIZ) | (2UL << 18) | (5UL << 22) |
+                              USB_OTG_DIEPCTL_SD0PID_SEVNFRM | USB_OTG_DIEPCTL_USBAEP;
+      USBx_INEP(5U)->DIEPINT = 0xFF;
+
       USBx_OUTEP(2U)->DOEPTSIZ = (1UL << 19) | 0x40U;
       USBx_OUTEP(2U)->DOEPCTL = (0x40U & USB_OTG_DOEPCTL_MPSIZ) | (2UL << 18) |
                                USB_OTG_DOEPCTL_SD0PID_SEVNFRM | USB_OTG_DOEPCTL_USBAEP;
@@ -600,6 +655,7 @@ void usb_irqhandler(void) {
   unsigned int gintsts = USBx->GINTSTS;
   unsigned int gotgint = USBx->GOTGINT;
   unsigned int daint = USBx_DEVICE->DAINT;
+  TRACE(TRACE_USB_IRQ, 0U, gintsts);
 
   // gintsts SUSPEND? 04008428
   #ifdef DEBUG_USB
@@ -671,7 +727,8 @@ void usb_irqhandler(void) {
       #endif
 
       if (endpoint == 2) {
-        comms_endpoint2_write((uint8_t *) usbdata, len);
+        outep2_processing = true;
+        (void)comms_endpoint2_write((uint8_t *) usbdata, len);
       }
 
       if (endpoint == 3) {
@@ -740,8 +797,9 @@ void usb_irqhandler(void) {
       #ifdef DEBUG_USB
         print("  OUT2 PACKET XFRC\n");
       #endif
-      USBx_OUTEP(2U)->DOEPTSIZ = (1UL << 19) | 0x40U;
-      USBx_OUTEP(2U)->DOEPCTL |= USB_OTG_DOEPCTL_EPENA | USB_OTG_DOEPCTL_CNAK;
+      // NAK cleared once there's room for the next packet
+      outep2_processing = false;
+      comms_endpoint2_resume_usb();
     }
 
     if ((USBx_OUTEP(3U)->DOEPINT & USB_OTG_DOEPINT_XFRC) != 0U) {
@@ -837,6 +895,18 @@ void usb_irqhandler(void) {
         break;
     }
 
+    #ifdef TRACE_ENABLED
+    // EP4 is bulk in both alt settings, a short packet ends the host's read once the trace is drained
+    if ((USBx_INEP(4U)->DIEPINT & USB_OTG_DIEPMSK_ITTXFEMSK) != 0U) {
+      USB_WritePacket((void *)response, trace_read(response, 0x40), 4);
+    }
+    #endif
+
+    // EP5 is bulk in both alt settings, whatever is in the SOM debug ring goes out, a short packet ends the read
+    if ((USBx_INEP(5U)->DIEPINT & USB_OTG_DIEPMSK_ITTXFEMSK) != 0U) {
+      USB_WritePacket((void *)response, comms_serial_read(response, 0x40), 5);
+    }
+
     if ((USBx_INEP(0U)->DIEPINT & USB_OTG_DIEPMSK_ITTXFEMSK) != 0U) {
       #ifdef DEBUG_USB
       print("  IN PACKET QUEUE\n");
@@ -858,12 +928,17 @@ void usb_irqhandler(void) {
     // clear interrupts
     USBx_INEP(0U)->DIEPINT = USBx_INEP(0U)->DIEPINT; // Why ep0?
     USBx_INEP(1U)->DIEPINT = USBx_INEP(1U)->DIEPINT;
+    #ifdef TRACE_ENABLED
+    USBx_INEP(4U)->DIEPINT = USBx_INEP(4U)->DIEPINT;
+    #endif
+    USBx_INEP(5U)->DIEPINT = USBx_INEP(5U)->DIEPINT;
   }
 
   // clear all interrupts we handled
   USBx_DEVICE->DAINT = daint;
   USBx->GOTGINT = gotgint;
   USBx->GINTSTS = gintsts;
+  TRACE(TRACE_USB_IRQ | TRACE_END, 0U, 0U);
 
   //USBx->GINTMSK = 0xFFFFFFFF & ~(USB_OTG_GINTMSK_NPTXFEM | USB_OTG_GINTMSK_PTXFEM | USB_OTG_GINTSTS_SOF | USB_OTG_GINTSTS_EOPF);
 }
@@ -876,3 +951,12 @@ void can_tx_comms_resume_usb(void) {
   }
   EXIT_CRITICAL();
 }
+
+void comms_endpoint2_resume_usb(void) {
+  ENTER_CRITICAL();
+  if (!outep2_processing && comms_endpoint2_ready() && ((USBx_OUTEP(2U)->DOEPCTL & USB_OTG_DOEPCTL_NAKSTS) != 0U)) {
+    USBx_OUTEP(2U)->DOEPTSIZ = (1UL << 19) | 0x40U;
+    USBx_OUTEP(2U)->DOEPCTL |= USB_OTG_DOEPCTL_EPENA | USB_OTG_DOEPCTL_CNAK;
+  }
+  EXIT_CRITICAL();
+}
@@ -0,0 +1,295 @@
+// FDCAN registers for the host FDCAN simulator (tests/libpanda/fdcan_sim.c).
+// Same layout and bit definitions as stm32h735xx.h, so llfdcan.h and fdcan.h build unmodified.
+#include <stdint.h>
+
+#define FDCAN_SIM
+
+typedef enum {
+  FDCAN1_IT0_IRQn = 19,
+  FDCAN2_IT0_IRQn = 20,
+  FDCAN1_IT1_IRQn = 21,
+  FDCAN2_IT1_IRQn = 22,
+  FDCAN3_IT0_IRQn = 159,
+  FDCAN3_IT1_IRQn = 160,
+  TIM2_IRQn = 28,
+} IRQn_Type;
+
+#define NUM_INTERRUPTS 163U
+#define CAN_INTERRUPT_RATE 16000U
+#define CAN_INIT_TIMER_IRQ TIM2_IRQn
+#define CAN_INIT_TIMER MICROSECOND_TIMER
+
+typedef struct {
+  volatile uint32_t CREL;
+  volatile uint32_t ENDN;
+  volatile uint32_t RESERVED1;
+  volatile uint32_t DBTP;
+  volatile uint32_t TEST;
+  volatile uint32_t RWD;
+  volatile uint32_t CCCR;
+  volatile uint32_t NBTP;
+  volatile uint32_t TSCC;
+  volatile uint32_t TSCV;
+  volatile uint32_t TOCC;
+  volatile uint32_t TOCV;
+  volatile uint32_t RESERVED2[4];
+  volatile uint32_t ECR;
+  volatile uint32_t PSR;
+  volatile uint32_t TDCR;
+  volatile uint32_t RESERVED3;
+  volatile uint32_t IR;
+  volatile uint32_t IE;
+  volatile uint32_t ILS;
+  volatile uint32_t ILE;
+  volatile uint32_t RESERVED4[8];
+  volatile uint32_t GFC;
+  volatile uint32_t SIDFC;
+  volatile uint32_t XIDFC;
+  volatile uint32_t RESERVED5;
+  volatile uint32_t XIDAM;
+  volatile uint32_t HPMS;
+  volatile uint32_t NDAT1;
+  volatile uint32_t NDAT2;
+  volatile uint32_t RXF0C;
+  volatile uint32_t RXF0S_REG[1];
+  volatile uint32_t RXF0A;
+  volatile uint32_t RXBC;
+  volatile uint32_t RXF1C;
+  volatile uint32_t RXF1S;
+  volatile uint32_t RXF1A;
+  volatile uint32_t RXESC;
+  volatile uint32_t TXBC;
+  volatile uint32_t TXFQS_REG[1];
+  volatile uint32_t TXESC;
+  volatile uint32_t TXBRP;
+  volatile uint32_t TXBAR;
+  volatile uint32_t TXBCR;
+  volatile uint32_t TXBTO;
+  volatile uint32_t TXBCF;
+  volatile uint32_t TXBTIE;
+  volatile uint32_t TXBCIE;
+  volatile uint32_t RESERVED6[2];
+  volatile uint32_t TXEFC;
+  volatile uint32_t TXEFS;
+  volatile uint32_t TXEFA;
+  volatile uint32_t RESERVED7;
+} FDCAN_GlobalTypeDef;
+
+// Plain memory can't react to a write, but the driver's RX loop needs the FIFO status to
+// follow its acknowledge writes. Every read of a status register first lets the simulated
+// core catch up with what the driver wrote since (RXF0A, TXBAR), like the hardware would.
+uint32_t fdcan_sim_sync(void);
+#define RXF0S RXF0S_REG[fdcan_sim_sync()]
+#define TXFQS TXFQS_REG[fdcan_sim_sync()]
+
+FDCAN_GlobalTypeDef fdcan_sim_regs[3];
+#define FDCAN1 (&fdcan_sim_regs[0])
+#define FDCAN2 (&fdcan_sim_regs[1])
+#define FDCAN3 (&fdcan_sim_regs[2])
+
+// message RAM, mapped at its real address by the simulator so the driver's address math works
+#define SRAMCAN_BASE 0x4000AC00UL
+#define SRAMCAN_SIZE 0x2800UL
+
+// register bits
+#define FDCAN_CCCR_ASM_Pos       (2U)
+#define FDCAN_CCCR_ASM_Msk       (0x1UL << FDCAN_CCCR_ASM_Pos)
+#define FDCAN_CCCR_ASM           FDCAN_CCCR_ASM_Msk
+#define FDCAN_CCCR_BRSE_Pos      (9U)
+#define FDCAN_CCCR_BRSE_Msk      (0x1UL << FDCAN_CCCR_BRSE_Pos)
+#define FDCAN_CCCR_BRSE          FDCAN_CCCR_BRSE_Msk
+#define FDCAN_CCCR_CCE_Pos       (1U)
+#define FDCAN_CCCR_CCE_Msk       (0x1UL << FDCAN_CCCR_CCE_Pos)
+#define FDCAN_CCCR_CCE           FDCAN_CCCR_CCE_Msk
+#define FDCAN_CCCR_CSA_Pos       (3U)
+#define FDCAN_CCCR_CSA_Msk       (0x1UL << FDCAN_CCCR_CSA_Pos)
+#define FDCAN_CCCR_CSA           FDCAN_CCCR_CSA_Msk
+#define FDCAN_CCCR_CSR_Pos       (4U)
+#define FDCAN_CCCR_CSR_Msk       (0x1UL << FDCAN_CCCR_CSR_Pos)
+#define FDCAN_CCCR_CSR           FDCAN_CCCR_CSR_Msk
+#define FDCAN_CCCR_DAR_Pos       (6U)
+#define FDCAN_CCCR_DAR_Msk       (0x1UL << FDCAN_CCCR_DAR_Pos)
+#define FDCAN_CCCR_DAR           FDCAN_CCCR_DAR_Msk
+#define FDCAN_CCCR_FDOE_Pos      (8U)
+#define FDCAN_CCCR_FDOE_Msk      (0x1UL << FDCAN_CCCR_FDOE_Pos)
+#define FDCAN_CCCR_FDOE          FDCAN_CCCR_FDOE_Msk
+#define FDCAN_CCCR_INIT_Pos      (0U)
+#define FDCAN_CCCR_INIT_Msk      (0x1UL << FDCAN_CCCR_INIT_Pos)
+#define FDCAN_CCCR_INIT          FDCAN_CCCR_INIT_Msk
+#define FDCAN_CCCR_MON_Pos       (5U)
+#define FDCAN_CCCR_MON_Msk       (0x1UL << FDCAN_CCCR_MON_Pos)
+#define FDCAN_CCCR_MON           FDCAN_CCCR_MON_Msk
+#define FDCAN_CCCR_NISO_Pos      (15U)
+#define FDCAN_CCCR_NISO_Msk      (0x1UL << FDCAN_CCCR_NISO_Pos)
+#define FDCAN_CCCR_NISO          FDCAN_CCCR_NISO_Msk
+#define FDCAN_CCCR_PXHD_Pos      (12U)
+#define FDCAN_CCCR_PXHD_Msk      (0x1UL << FDCAN_CCCR_PXHD_Pos)
+#define FDCAN_CCCR_PXHD          FDCAN_CCCR_PXHD_Msk
+#define FDCAN_CCCR_TEST_Pos      (7U)
+#define FDCAN_CCCR_TEST_Msk      (0x1UL << FDCAN_CCCR_TEST_Pos)
+#define FDCAN_CCCR_TEST          FDCAN_CCCR_TEST_Msk
+#define FDCAN_CCCR_TXP_Pos       (14U)
+#define FDCAN_CCCR_TXP_Msk       (0x1UL << FDCAN_CCCR_TXP_Pos)
+#define FDCAN_CCCR_TXP           FDCAN_CCCR_TXP_Msk
+#define FDCAN_DBTP_DBRP_Pos      (16U)
+#define FDCAN_DBTP_DBRP_Msk      (0x1FUL << FDCAN_DBTP_DBRP_Pos)
+#define FDCAN_DBTP_DBRP          FDCAN_DBTP_DBRP_Msk
+#define FDCAN_DBTP_DSJW_Pos      (0U)
+#define FDCAN_DBTP_DSJW_Msk      (0xFUL << FDCAN_DBTP_DSJW_Pos)
+#define FDCAN_DBTP_DSJW          FDCAN_DBTP_DSJW_Msk
+#define FDCAN_DBTP_DTSEG1_Pos    (8U)
+#define FDCAN_DBTP_DTSEG1_Msk    (0x1FUL << FDCAN_DBTP_DTSEG1_Pos)
+#define FDCAN_DBTP_DTSEG1        FDCAN_DBTP_DTSEG1_Msk
+#define FDCAN_DBTP_DTSEG2_Pos    (4U)
+#define FDCAN_DBTP_DTSEG2_Msk    (0xFUL << FDCAN_DBTP_DTSEG2_Pos)
+#define FDCAN_DBTP_DTSEG2        FDCAN_DBTP_DTSEG2_Msk
+#define FDCAN_ECR_REC_Pos        (8U)
+#define FDCAN_ECR_REC_Msk        (0x7FUL << FDCAN_ECR_REC_Pos)
+#define FDCAN_ECR_REC            FDCAN_ECR_REC_Msk
+#define FDCAN_ECR_TEC_Pos        (0U)
+#define FDCAN_ECR_TEC_Msk        (0xFFUL << FDCAN_ECR_TEC_Pos)
+#define FDCAN_ECR_TEC            FDCAN_ECR_TEC_Msk
+#define FDCAN_GFC_ANFE_Pos       (2U)
+#define FDCAN_GFC_ANFE_Msk       (0x3UL << FDCAN_GFC_ANFE_Pos)
+#define FDCAN_GFC_ANFE           FDCAN_GFC_ANFE_Msk
+#define FDCAN_GFC_ANFS_Pos       (4U)
+#define FDCAN_GFC_ANFS_Msk       (0x3UL << FDCAN_GFC_ANFS_Pos)
+#define FDCAN_GFC_ANFS           FDCAN_GFC_ANFS_Msk
+#define FDCAN_GFC_RRFE_Pos       (0U)
+#define FDCAN_GFC_RRFE_Msk       (0x1UL << FDCAN_GFC_RRFE_Pos)
+#define FDCAN_GFC_RRFE           FDCAN_GFC_RRFE_Msk
+#define FDCAN_GFC_RRFS_Pos       (1U)
+#define FDCAN_GFC_RRFS_Msk       (0x1UL << FDCAN_GFC_RRFS_Pos)
+#define FDCAN_GFC_RRFS           FDCAN_GFC_RRFS_Msk
+#define FDCAN_IE_BOE_Pos         (25U)
+#define FDCAN_IE_BOE_Msk         (0x1UL << FDCAN_IE_BOE_Pos)
+#define FDCAN_IE_BOE             FDCAN_IE_BOE_Msk
+#define FDCAN_IE_EPE_Pos         (23U)
+#define FDCAN_IE_EPE_Msk         (0x1UL << FDCAN_IE_EPE_Pos)
+#define FDCAN_IE_EPE             FDCAN_IE_EPE_Msk
+#define FDCAN_IE_PEAE_Pos        (27U)
+#define FDCAN_IE_PEAE_Msk        (0x1UL << FDCAN_IE_PEAE_Pos)
+#define FDCAN_IE_PEAE            FDCAN_IE_PEAE_Msk
+#define FDCAN_IE_PEDE_Pos        (28U)
+#define FDCAN_IE_PEDE_Msk        (0x1UL << FDCAN_IE_PEDE_Pos)
+#define FDCAN_IE_PEDE            FDCAN_IE_PEDE_Msk
+#define FDCAN_IE_RF0LE_Pos       (3U)
+#define FDCAN_IE_RF0LE_Msk       (0x1UL << FDCAN_IE_RF0LE_Pos)
+#define FDCAN_IE_RF0LE           FDCAN_IE_RF0LE_Msk
+#define FDCAN_IE_RF0NE_Pos       (0U)
+#define FDCAN_IE_RF0NE_Msk       (0x1UL << FDCAN_IE_RF0NE_Pos)
+#define FDCAN_IE_RF0NE           FDCAN_IE_RF0NE_Msk
+#define FDCAN_IE_TFEE_Pos        (11U)
+#define FDCAN_IE_TFEE_Msk        (0x1UL << FDCAN_IE_TFEE_Pos)
+#define FDCAN_IE_TFEE            FDCAN_IE_TFEE_Msk
+#define FDCAN_ILE_EINT0_Pos      (0U)
+#define FDCAN_ILE_EINT0_Msk      (0x1UL << FDCAN_ILE_EINT0_Pos)
+#define FDCAN_ILE_EINT0          FDCAN_ILE_EINT0_Msk
+#define FDCAN_ILE_EINT1_Pos      (1U)
+#define FDCAN_ILE_EINT1_Msk      (0x1UL << FDCAN_ILE_EINT1_Pos)
+#define FDCAN_ILE_EINT1          FDCAN_ILE_EINT1_Msk
+#define FDCAN_ILS_TFEL_Pos       (11U)
+#define FDCAN_ILS_TFEL_Msk       (0x1UL << FDCAN_ILS_TFEL_Pos)
+#define FDCAN_ILS_TFEL           FDCAN_ILS_TFEL_Msk
+#define FDCAN_IR_BO_Pos          (25U)
+#define FDCAN_IR_BO_Msk          (0x1UL << FDCAN_IR_BO_Pos)
+#define FDCAN_IR_BO              FDCAN_IR_BO_Msk
+#define FDCAN_IR_EP_Pos          (23U)
+#define FDCAN_IR_EP_Msk          (0x1UL << FDCAN_IR_EP_Pos)
+#define FDCAN_IR_EP              FDCAN_IR_EP_Msk
+#define FDCAN_IR_PEA_Pos         (27U)
+#define FDCAN_IR_PEA_Msk         (0x1UL << FDCAN_IR_PEA_Pos)
+#define FDCAN_IR_PEA             FDCAN_IR_PEA_Msk
+#define FDCAN_IR_PED_Pos         (28U)
+#define FDCAN_IR_PED_Msk         (0x1UL << FDCAN_IR_PED_Pos)
+#define FDCAN_IR_PED             FDCAN_IR_PED_Msk
+#define FDCAN_IR_RF0L_Pos        (3U)
+#define FDCAN_IR_RF0L_Msk        (0x1UL << FDCAN_IR_RF0L_Pos)
+#define FDCAN_IR_RF0L            FDCAN_IR_RF0L_Msk
+#define FDCAN_IR_RF0N_Pos        (0U)
+#define FDCAN_IR_RF0N_Msk        (0x1UL << FDCAN_IR_RF0N_Pos)
+#define FDCAN_IR_RF0N            FDCAN_IR_RF0N_Msk
+#define FDCAN_IR_TFE_Pos         (11U)
+#define FDCAN_IR_TFE_Msk         (0x1UL << FDCAN_IR_TFE_Pos)
+#define FDCAN_IR_TFE             FDCAN_IR_TFE_Msk
+#define FDCAN_NBTP_NBRP_Pos      (16U)
+#define FDCAN_NBTP_NBRP_Msk      (0x1FFUL << FDCAN_NBTP_NBRP_Pos)
+#define FDCAN_NBTP_NBRP          FDCAN_NBTP_NBRP_Msk
+#define FDCAN_NBTP_NSJW_Pos      (25U)
+#define FDCAN_NBTP_NSJW_Msk      (0x7FUL << FDCAN_NBTP_NSJW_Pos)
+#define FDCAN_NBTP_NSJW          FDCAN_NBTP_NSJW_Msk
+#define FDCAN_NBTP_NTSEG1_Pos    (8U)
+#define FDCAN_NBTP_NTSEG1_Msk    (0xFFUL << FDCAN_NBTP_NTSEG1_Pos)
+#define FDCAN_NBTP_NTSEG1        FDCAN_NBTP_NTSEG1_Msk
+#define FDCAN_NBTP_NTSEG2_Pos    (0U)
+#define FDCAN_NBTP_NTSEG2_Msk    (0x7FUL << FDCAN_NBTP_NTSEG2_Pos)
+#define FDCAN_NBTP_NTSEG2        FDCAN_NBTP_NTSEG2_Msk
+#define FDCAN_PSR_BO_Pos         (7U)
+#define FDCAN_PSR_BO_Msk         (0x1UL << FDCAN_PSR_BO_Pos)
+#define FDCAN_PSR_BO             FDCAN_PSR_BO_Msk
+#define FDCAN_PSR_DLEC_Pos       (8U)
+#define FDCAN_PSR_DLEC_Msk       (0x7UL << FDCAN_PSR_DLEC_Pos)
+#define FDCAN_PSR_DLEC           FDCAN_PSR_DLEC_Msk
+#define FDCAN_PSR_EP_Pos         (5U)
+#define FDCAN_PSR_EP_Msk         (0x1UL << FDCAN_PSR_EP_Pos)
+#define FDCAN_PSR_EP             FDCAN_PSR_EP_Msk
+#define FDCAN_PSR_EW_Pos         (6U)
+#define FDCAN_PSR_EW_Msk         (0x1UL << FDCAN_PSR_EW_Pos)
+#define FDCAN_PSR_EW             FDCAN_PSR_EW_Msk
+#define FDCAN_PSR_LEC_Pos        (0U)
+#define FDCAN_PSR_LEC_Msk        (0x7UL << FDCAN_PSR_LEC_Pos)
+#define FDCAN_PSR_LEC            FDCAN_PSR_LEC_Msk
+#define FDCAN_RXESC_F0DS_Pos     (0U)
+#define FDCAN_RXESC_F0DS_Msk     (0x7UL << FDCAN_RXESC_F0DS_Pos)
+#define FDCAN_RXESC_F0DS         FDCAN_RXESC_F0DS_Msk
+#define FDCAN_RXF0C_F0OM_Pos     (31U)
+#define FDCAN_RXF0C_F0OM_Msk     (0x1UL << FDCAN_RXF0C_F0OM_Pos)
+#define FDCAN_RXF0C_F0OM         FDCAN_RXF0C_F0OM_Msk
+#define FDCAN_RXF0C_F0S_Pos      (16U)
+#define FDCAN_RXF0C_F0S_Msk      (0x7FUL << FDCAN_RXF0C_F0S_Pos)
+#define FDCAN_RXF0C_F0S          FDCAN_RXF0C_F0S_Msk
+#define FDCAN_RXF0C_F0SA_Pos     (2U)
+#define FDCAN_RXF0C_F0SA_Msk     (0x3FFFUL << FDCAN_RXF0C_F0SA_Pos)
+#define FDCAN_RXF0C_F0SA         FDCAN_RXF0C_F0SA_Msk
+#define FDCAN_RXF0S_F0F_Pos      (24U)
+#define FDCAN_RXF0S_F0F_Msk      (0x1UL << FDCAN_RXF0S_F0F_Pos)
+#define FDCAN_RXF0S_F0F          FDCAN_RXF0S_F0F_Msk
+#define FDCAN_RXF0S_F0FL_Pos     (0U)
+#define FDCAN_RXF0S_F0FL_Msk     (0x7FUL << FDCAN_RXF0S_F0FL_Pos)
+#define FDCAN_RXF0S_F0FL         FDCAN_RXF0S_F0FL_Msk
+#define FDCAN_RXF0S_F0GI_Pos     (8U)
+#define FDCAN_RXF0S_F0GI_Msk     (0x3FUL << FDCAN_RXF0S_F0GI_Pos)
+#define FDCAN_RXF0S_F0GI         FDCAN_RXF0S_F0GI_Msk
+#define FDCAN_RXF0S_F0PI_Pos     (16U)
+#define FDCAN_RXF0S_F0PI_Msk     (0x3FUL << FDCAN_RXF0S_F0PI_Pos)
+#define FDCAN_RXF0S_F0PI         FDCAN_RXF0S_F0PI_Msk
+#define FDCAN_SIDFC_LSS_Pos      (16U)
+#define FDCAN_SIDFC_LSS_Msk      (0xFFUL << FDCAN_SIDFC_LSS_Pos)
+#define FDCAN_SIDFC_LSS          FDCAN_SIDFC_LSS_Msk
+#define FDCAN_TEST_LBCK_Pos      (4U)
+#define FDCAN_TEST_LBCK_Msk      (0x1UL << FDCAN_TEST_LBCK_Pos)
+#define FDCAN_TEST_LBCK          FDCAN_TEST_LBCK_Msk
+#define FDCAN_TXBC_TBSA_Pos      (2U)
+#define FDCAN_TXBC_TBSA_Msk      (0x3FFFUL << FDCAN_TXBC_TBSA_Pos)
+#define FDCAN_TXBC_TBSA          FDCAN_TXBC_TBSA_Msk
+#define FDCAN_TXBC_TFQM_Pos      (30U)
+#define FDCAN_TXBC_TFQM_Msk      (0x1UL << FDCAN_TXBC_TFQM_Pos)
+#define FDCAN_TXBC_TFQM          FDCAN_TXBC_TFQM_Msk
+#define FDCAN_TXBC_TFQS_Pos      (24U)
+#define FDCAN_TXBC_TFQS_Msk      (0x3FUL << FDCAN_TXBC_TFQS_Pos)
+#define FDCAN_TXBC_TFQS          FDCAN_TXBC_TFQS_Msk
+#define FDCAN_TXESC_TBDS_Pos     (0U)
+#define FDCAN_TXESC_TBDS_Msk     (0x7UL << FDCAN_TXESC_TBDS_Pos)
+#define FDCAN_TXESC_TBDS         FDCAN_TXESC_TBDS_Msk
+#define FDCAN_TXFQS_TFFL_Pos     (0U)
+#define FDCAN_TXFQS_TFFL_Msk     (0x3FUL << FDCAN_TXFQS_TFFL_Pos)
+#define FDCAN_TXFQS_TFFL         FDCAN_TXFQS_TFFL_Msk
+#define FDCAN_TXFQS_TFQF_Pos     (21U)
+#define FDCAN_TXFQS_TFQF_Msk     (0x1UL << FDCAN_TXFQS_TFQF_Pos)
+#define FDCAN_TXFQS_TFQF         FDCAN_TXFQS_TFQF_Msk
+#define FDCAN_TXFQS_TFQPI_Pos    (16U)
+#define FDCAN_TXFQS_TFQPI_Msk    (0x1FUL << FDCAN_TXFQS_TFQPI_Pos)
+#define FDCAN_TXFQS_TFQPI        FDCAN_TXFQS_TFQPI_Msk
+#define FDCAN_XIDFC_LSE_Pos      (16U)
+#define FDCAN_XIDFC_LSE_Msk      (0x7FUL << FDCAN_XIDFC_LSE_Pos)
+#define FDCAN_XIDFC_LSE          FDCAN_XIDFC_LSE_Msk
@@ -4,6 +4,8 @@
 #include <stdlib.h>
 
 #include "utils.h"
+#include "probe.h"
+#include "trace.h"
 
 #define ALLOW_DEBUG
 
@@ -20,8 +22,14 @@ void puth(unsigned int i) {
 
 typedef struct {
   uint32_t CNT;
+  uint32_t SR;
+  uint32_t DIER;
+  uint32_t CCR1;
 } TIM_TypeDef;
 
+#define TIM_SR_CC1IF (1UL << 1)
+#define TIM_DIER_CC1IE (1UL << 1)
+
 TIM_TypeDef timer;
 TIM_TypeDef *MICROSECOND_TIMER = &timer;
 uint32_t microsecond_timer_get(void);
@@ -1,10 +1,130 @@
 // from the linker script
 #define APP_START_ADDRESS 0x8020000U
 
+// capability flags in the 0xb0 response
+#define FLASHER_CAP_DELTA 1U  // 0xb4 sector hash and 0xb6 seek
+
 // flasher state variables
 uint32_t *prog_ptr = NULL;
 bool unlocked = false;
 
+static uint8_t flash_sector(const uint32_t *addr) {
+  return ((uint32_t)addr - FLASH_BANK1_BASE) / FLASH_SECTOR_SIZE;
+}
+
+// per-sector timing, read back over 0xb0. timed with the DWT cycle counter,
+// which boot_profile_init() started
+uint32_t flash_erase_us[8];
+uint32_t flash_program_us[8];
+uint32_t flash_program_start[8];  // cycles at the first flash word programmed, 0 if none yet
+uint8_t flash_erase_sector_timed = 0U;  // background erase in flight, 0 if none
+uint32_t flash_erase_start = 0U;
+
+static void flash_timing_reset(void) {
+  for (uint8_t i = 0U; i < 8U; i++) {
+    flash_erase_us[i] = 0U;
+    flash_program_us[i] = 0U;
+    flash_program_start[i] = 0U;
+  }
+  flash_erase_sector_timed = 0U;
+}
+
+// program time is from the first to the last flash word written into the sector,
+// which includes waiting on the host for data
+static void flash_program_timed(uint32_t *addr, const uint32_t *data, uint32_t len) {
+  uint8_t sec = flash_sector(addr);
+  uint32_t now = DWT->CYCCNT;
+  if (sec < 8U) {
+    if (flash_program_start[sec] == 0U) {
+      flash_program_start[sec] = now | 1U;
+    }
+    flash_program_us[sec] = (now - flash_program_start[sec]) / CORE_FREQ;
+  }
+  flash_write_words(addr, data, len);
+}
+
+// EP2 data is staged into full flash words, which are then programmed back-to-back
+uint32_t flash_word[FLASH_WORD_WORDS];
+uint32_t flash_word_len = 0U;
+
+static void flash_word_flush(void) {
+  if (flash_word_len > 0U) {
+    flash_program_timed(prog_ptr, flash_word, flash_word_len);
+    prog_ptr += flash_word_len;
+    flash_word_len = 0U;
+  }
+  flush_write_buffer();
+}
+
+// erase-ahead: after 0xb3, the host streams data right away. Data is staged
+// in RAM, and flasher_service() interleaves starting the next sector erase
+// with programming staged flash words into sectors that are already erased.
+// This is a single bank part and the USB/SPI handlers run from it, so they
+// stall while an erase or program runs. The ring only saves the host a round
+// trip per erase. When it's full, EP2 is NAKed (SPI is NACKed) until
+// flasher_service() frees up room.
+#define FLASH_STAGE_WORDS 8192U  // 32KB
+uint32_t flash_stage[FLASH_STAGE_WORDS];
+uint32_t flash_stage_head = 0U;  // free-running, in words
+uint32_t flash_stage_tail = 0U;
+bool erase_ahead = false;
+uint8_t erase_next = 1U;
+uint8_t erase_last = 0U;
+bool flash_error = false;
+
+// starts at most one flash operation, returns true while there is work left
+static bool flasher_service(bool drain) {
+  bool pending = false;
+  bool freed = false;
+
+  ENTER_CRITICAL();
+  if (erase_ahead) {
+    uint32_t staged = flash_stage_head - flash_stage_tail;
+    pending = (staged > 0U) || (erase_next <= erase_last) || flash_busy();
+
+    if (!flash_busy()) {
+      if (flash_erase_sector_timed != 0U) {
+        flash_erase_us[flash_erase_sector_timed] = (DWT->CYCCNT - flash_erase_start) / CORE_FREQ;
+        flash_erase_sector_timed = 0U;
+      }
+
+      uint32_t n = MIN(staged, FLASH_WORD_WORDS);
+      bool erased = flash_sector(prog_ptr) < erase_next;
+      if (erased && ((n == FLASH_WORD_WORDS) || (drain && (n > 0U)))) {
+        for (uint32_t i = 0U; i < n; i++) {
+          flash_word[i] = flash_stage[(flash_stage_tail + i) % FLASH_STAGE_WORDS];
+        }
+        flash_program_timed(prog_ptr, flash_word, n);
+        if (n < FLASH_WORD_WORDS) {
+          flush_write_buffer();
+        }
+        prog_ptr += n;
+        flash_stage_tail += n;
+        freed = true;
+      } else if (erase_next <= erase_last) {
+        flash_erase_start = DWT->CYCCNT;
+        if (flash_erase_sector_start(erase_next, unlocked)) {
+          flash_erase_sector_timed = erase_next;
+        }
+        erase_next++;
+      } else if (!erased && (staged > 0U)) {
+        // data past the last erased sector, drop it instead of programming over old data
+        flash_error = true;
+        flash_stage_tail = flash_stage_head;
+        freed = true;
+      } else {
+        pending = (staged >= FLASH_WORD_WORDS) || (drain && (staged > 0U));
+      }
+    }
+  }
+  EXIT_CRITICAL();
+
+  if (freed) {
+    comms_endpoint2_resume_usb();
+  }
+  return pending;
+}
+
 int comms_control_handler(ControlPacket_t *req, uint8_t *resp) {
   int resp_len = 0;
 
@@ -15,13 +135,26 @@ int comms_control_handler(ControlPacket_t *req, uint8_t *resp) {
   resp[2] = req->request;
   resp[3] = ~req->request;
   *((uint32_t **)&resp[8]) = prog_ptr;
-  resp_len = 0xc;
+  // erase-ahead status
+  resp[12] = erase_next;
+  resp[13] = erase_last;
+  resp[14] = flash_busy() ? 1U : 0U;
+  resp[15] = flash_error ? 1U : 0U;
+  *((uint32_t *)&resp[16]) = (flash_stage_head - flash_stage_tail) * 4U;
+  resp_len = 0x14;
 
   int sec;
   switch (req->request) {
     // **** 0xb0: flasher echo
     case 0xb0:
       resp[1] = 0xff;
+      // erase and program time of sector param1, in us
+      if (req->param1 < 8U) {
+        *((uint32_t *)&resp[20]) = flash_erase_us[req->param1];
+        *((uint32_t *)&resp[24]) = flash_program_us[req->param1];
+      }
+      *((uint32_t *)&resp[28]) = FLASHER_CAP_DELTA;
+      resp_len = 0x20;
       break;
     // **** 0xb1: unlock flash
     case 0xb1:
@@ -32,11 +165,43 @@ int comms_control_handler(ControlPacket_t *req, uint8_t *resp) {
       led_set(LED_GREEN, 1);
       unlocked = true;
       prog_ptr = (uint32_t *)APP_START_ADDRESS;
+      flash_word_len = 0U;
+      erase_ahead = false;
+      flash_stage_head = 0U;
+      flash_stage_tail = 0U;
+      flash_error = false;
+      flash_timing_reset();
       break;
     // **** 0xb2: erase sector
     case 0xb2:
       sec = req->param1;
+      flash_erase_start = DWT->CYCCNT;
       if (flash_erase_sector(sec, unlocked)) {
+        flash_erase_us[sec] = (DWT->CYCCNT - flash_erase_start) / CORE_FREQ;
+        resp[1] = 0xff;
+      }
+      break;
+    // **** 0xb3: erase sectors 1 - param1 in the background, ahead of the EP2 data
+    case 0xb3:
+      if (unlocked && (req->param1 < 8U)) {
+        erase_ahead = true;
+        erase_next = 1U;
+        erase_last = req->param1;
+        resp[1] = 0xff;
+      }
+      break;
+    // **** 0xb4: SHA1 of the first param2 words of sector param1, for delta updates
+    case 0xb4:
+      if ((req->param1 >= 1U) && (req->param1 < 8U) && (req->param2 <= (FLASH_SECTOR_SIZE / 4U))) {
+        SHA_hash((const void *)(FLASH_BANK1_BASE + (req->param1 * FLASH_SECTOR_SIZE)), req->param2 * 4U, resp);
+        resp_len = SHA_DIGEST_SIZE;
+      }
+      break;
+    // **** 0xb6: move the write pointer to the start of sector param1, for delta updates
+    case 0xb6:
+      if (unlocked && !erase_ahead && (req->param1 >= 1U) && (req->param1 < 7U)) {
+        flash_word_flush();
+        prog_ptr = (uint32_t *)(FLASH_BANK1_BASE + (req->param1 * FLASH_SECTOR_SIZE));
         resp[1] = 0xff;
       }
       break;
@@ -85,7 +250,8 @@ int comms_control_handler(ControlPacket_t *req, uint8_t *resp) {
       break;
     // **** 0xd8: reset ST
     case 0xd8:
-      flush_write_buffer();
+      while (flasher_service(true)) {}
+      flash_word_flush();
       NVIC_SystemReset();
       break;
   }
@@ -103,17 +269,44 @@ int comms_can_read(uint8_t *data, uint32_t max_len) {
   return 0;
 }
 
+int comms_serial_read(uint8_t *data, uint32_t max_len) {
+  UNUSED(data);
+  UNUSED(max_len);
+  return 0;
+}
+
 void refresh_can_tx_slots_available(void) {}
 
-void comms_endpoint2_write(const uint8_t *data, uint32_t len) {
-  led_set(LED_RED, 0);
-  for (uint32_t i = 0; i < len/4; i++) {
-    flash_write_word(prog_ptr, *(uint32_t*)(data+(i*4)));
+static uint32_t flash_stage_free(void) {
+  return FLASH_STAGE_WORDS - (flash_stage_head - flash_stage_tail);
+}
 
-    //*(uint64_t*)(&spi_tx_buf[0x30+(i*4)]) = *prog_ptr;
-    prog_ptr++;
+bool comms_endpoint2_ready(void) {
+  return !erase_ahead || (flash_stage_free() >= (USBPACKET_MAX_SIZE / 4U));
+}
+
+bool comms_endpoint2_write(const uint8_t *data, uint32_t len) {
+  // all or nothing, EP2 is only armed with room for a packet and SPI gets a NACK
+  if (erase_ahead && (flash_stage_free() < (len / 4U))) {
+    return false;
+  }
+
+  led_set(LED_RED, 0);
+  for (uint32_t i = 0; (i < len/4) && erase_ahead; i++) {
+    flash_stage[flash_stage_head % FLASH_STAGE_WORDS] = *(uint32_t*)(data+(i*4));
+    flash_stage_head++;
+  }
+  for (uint32_t i = 0; (i < len/4) && !erase_ahead; i++) {
+    flash_word[flash_word_len] = *(uint32_t*)(data+(i*4));
+    flash_word_len++;
+    if (flash_word_len == FLASH_WORD_WORDS) {
+      flash_program_timed(prog_ptr, flash_word, FLASH_WORD_WORDS);
+      prog_ptr += FLASH_WORD_WORDS;
+      flash_word_len = 0U;
+    }
   }
   led_set(LED_RED, 1);
+  return true;
 }
 
 
@@ -140,11 +333,13 @@ void soft_flasher_start(void) {
 
   enable_interrupts();
 
+  bool led_on = false;
   for (;;) {
-    // blink the green LED fast
-    led_set(LED_GREEN, 0);
-    delay(500000);
-    led_set(LED_GREEN, 1);
-    delay(500000);
+    // blink the green LED fast, while running the erase-ahead pipeline
+    for (uint32_t i = 0U; i < 100000U; i++) {
+      (void)flasher_service(false);
+    }
+    led_set(LED_GREEN, led_on);
+    led_on = !led_on;
   }
 }
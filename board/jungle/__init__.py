@@ -50,10 +50,10 @@ class PandaJungle(Panda):
   def spi_connect(cls, serial, ignore_version=False):
     return None, None, None, None
 
-  def flash(self, fn=None, code=None, reconnect=True):
+  def flash(self, fn=None, code=None, reconnect=True, delta=False):
     if not fn:
       fn = os.path.join(FW_PATH, McuType.H7.config.app_fn.replace("panda", "panda_jungle"))
-    super().flash(fn=fn, code=code, reconnect=reconnect)
+    return super().flash(fn=fn, code=code, reconnect=reconnect, delta=delta)
 
   def recover(self, timeout: int | None = 60, reset: bool = True) -> bool:
     dfu_serial = self.get_dfu_serial()
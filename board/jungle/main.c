@@ -8,6 +8,7 @@
 #include "board/drivers/usb.h"
 
 #include "board/early_init.h"
+#include "board/boot_profile.h"
 #include "board/provision.h"
 
 #include "board/health.h"
@@ -52,10 +53,12 @@ void tick_handler(void) {
     if (generated_can_traffic) {
       for (int i = 0; i < 3; i++) {
         if (can_health[i].transmit_error_cnt >= 128) {
-          (void)llcan_init(CANIF_FROM_CAN_NUM(i));
+          (void)can_init((uint8_t)i);
         }
       }
     }
+    can_init_tick();
+    check_registers();
 
     // decimated to 1Hz
     if ((loop_counter % 8) == 0U) {
@@ -69,9 +72,6 @@ void tick_handler(void) {
 
       current_board->board_tick();
 
-      // check registers
-      check_registers();
-
       // turn off the blue LED, turned on by CAN
       led_set(LED_BLUE, false);
 
@@ -8,6 +8,7 @@
 #include "board/drivers/bootkick.h"
 
 #include "board/early_init.h"
+#include "board/boot_profile.h"
 #include "board/provision.h"
 
 #include "opendbc/safety/safety.h"
@@ -37,8 +38,7 @@ void debug_ring_callback(uart_ring *ring) {
 
 // ****************************** safety mode ******************************
 
-// this is the only way to leave silent mode
-void set_safety_mode(uint16_t mode, uint16_t param) {
+static void apply_safety_mode(uint16_t mode, uint16_t param) {
   uint16_t mode_copy = mode;
   int err = set_safety_hooks(mode_copy, param);
   if (err == -1) {
@@ -85,6 +85,11 @@ void set_safety_mode(uint16_t mode, uint16_t param) {
       can_silent = false;
       break;
   }
+}
+
+// this is the only way to leave silent mode
+void set_safety_mode(uint16_t mode, uint16_t param) {
+  apply_safety_mode(mode, param);
   can_init_all();
 }
 
@@ -127,9 +132,11 @@ static void tick_handler(void) {
 
     // tick drivers at 8Hz
     fan_tick();
+    can_init_tick();
     harness_tick();
     simple_watchdog_kick();
     sound_tick();
+    check_registers();
 
     if (relay_malfunction_prev != relay_malfunction) {
       if (relay_malfunction) {
@@ -246,9 +253,6 @@ static void tick_handler(void) {
         }
       }
 
-      // check registers
-      check_registers();
-
       // set ignition_can to false after 2s of no CAN seen
       if (ignition_can_cnt > 2U) {
         ignition_can = false;
@@ -275,6 +279,7 @@ int main(void) {
 
   // shouldn't have interrupts here, but just in case
   disable_interrupts();
+  boot_profile_app_start();
 
   // init early devices
   clock_init();
@@ -285,6 +290,7 @@ int main(void) {
   led_set(LED_RED, true);
   led_set(LED_GREEN, true);
   adc_init(ADC1);
+  boot_profile_stage(BOOT_STAGE_APP_EARLY, CORE_FREQ);
 
   // print hello
   print("\n\n\n************************ MAIN START ************************\n");
@@ -298,23 +304,31 @@ int main(void) {
   // init board
   current_board->init();
   current_board->set_can_mode(CAN_MODE_NORMAL);
-  harness_init();
 
   // panda has an FPU, let's use it!
   enable_fpu();
 
   microsecond_timer_init();
+  boot_profile_stage(BOOT_STAGE_APP_BOARD, CORE_FREQ);
+
+  // fast start: bring the CAN cores up (silent) before the slow analog calibration,
+  // so they're synchronizing to the bus and receiving while the ADC oversamples
+  can_init_all();
+  enable_can_transceivers(true);
+  boot_profile_stage(BOOT_STAGE_APP_CAN, CORE_FREQ);
+
+  // harness detection does the first ADC read, which calibrates AVDD
+  harness_init();
 
   current_board->set_siren(false);
   if (current_board->has_fan) {
     fan_init();
   }
+  boot_profile_stage(BOOT_STAGE_APP_ANALOG, CORE_FREQ);
 
-  // init to SILENT and can silent
-  set_safety_mode(SAFETY_SILENT, 0U);
-
-  // enable CAN TXs
-  enable_can_transceivers(true);
+  // init to SILENT, CAN is already up in silent mode
+  apply_safety_mode(SAFETY_SILENT, 0U);
+  boot_profile_stage(BOOT_STAGE_APP_SAFETY, CORE_FREQ);
 
   // init watchdog for heartbeat loop, fed at 8Hz
   simple_watchdog_init(FAULT_HEARTBEAT_LOOP_WATCHDOG, (3U * 1000000U / 8U));
@@ -338,52 +352,31 @@ int main(void) {
   led_set(LED_GREEN, false);
   led_set(LED_BLUE, false);
 
+  boot_profile_stage(BOOT_STAGE_APP_COMMS, CORE_FREQ);
+  boot_profile_rx_arm();
+
   print("**** INTERRUPTS ON ****\n");
   enable_interrupts();
 
-  // LED should keep on blinking all the time
+  // red LED fades as a heartbeat while not power saving
+  led_fade_init();
+
+  // everything is interrupt driven, sleep in between at full clock
   while (true) {
     #ifdef ALLOW_DEBUG
     if (stop_mode_requested) {
       enter_stop_mode();
     }
     #endif
-    if (!power_save_enabled) {
-      #ifdef DEBUG_FAULTS
-      if (fault_status == FAULT_STATUS_NONE) {
-      #endif
-        // useful for debugging, fade breaks = panda is overloaded
-        for (uint32_t fade = 0U; fade < MAX_LED_FADE; fade += 1U) {
-          led_set(LED_RED, true);
-          delay(fade >> 4);
-          led_set(LED_RED, false);
-          delay((MAX_LED_FADE - fade) >> 4);
-        }
+    led_fade_enable(!power_save_enabled);
 
-        for (uint32_t fade = MAX_LED_FADE; fade > 0U; fade -= 1U) {
-          led_set(LED_RED, true);
-          delay(fade >> 4);
-          led_set(LED_RED, false);
-          delay((MAX_LED_FADE - fade) >> 4);
-        }
-
-      #ifdef DEBUG_FAULTS
-      } else {
-          led_set(LED_RED, 1);
-          delay(512000U);
-          led_set(LED_RED, 0);
-          delay(512000U);
-        }
-      #endif
-    } else {
-      if ((hw_type == HW_TYPE_CUATRO) && !current_board->read_som_gpio()) {
-        assert_fatal(current_safety_mode == SAFETY_SILENT, "Error: Entering low power mode while not in SAFETY_SILENT. Hanging\n");
-        enter_stop_mode(); // deep sleep, wakes on CAN or SBU activity
-        assert_fatal(false, "Error: enter_stop_mode returned after system reset. Hanging\n");
-      }
-      __WFI();
-      SCB->SCR &= ~SCB_SCR_SLEEPDEEP_Msk;
+    if (power_save_enabled && (hw_type == HW_TYPE_CUATRO) && !current_board->read_som_gpio()) {
+      assert_fatal(current_safety_mode == SAFETY_SILENT, "Error: Entering low power mode while not in SAFETY_SILENT. Hanging\n");
+      enter_stop_mode(); // deep sleep, wakes on CAN or SBU activity
+      assert_fatal(false, "Error: enter_stop_mode returned after system reset. Hanging\n");
     }
+    idle_sleep();
+    SCB->SCR &= ~SCB_SCR_SLEEPDEEP_Msk;
   }
 
   return 0;
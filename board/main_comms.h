@@ -47,21 +47,73 @@ static int get_health_pkt(void *dat) {
   health->controls_allowed_lateral_pkt = controls_allowed || controls_allowed_lateral;
   health->controls_allowed_longitudinal_pkt = controls_allowed;
 
+  health->sbu_measure_max_us_pkt = (uint16_t)MIN(harness.sbu_measure_max_us, 0xFFFFU);
+
   return sizeof(*health);
 }
 
-// send on serial, first byte to select the ring
-void comms_endpoint2_write(const uint8_t *data, uint32_t len) {
-  uart_ring *ur = get_ring_by_number(data[0]);
-  if ((len != 0U) && (ur != NULL)) {
-    if ((data[0] < 2U) || (data[0] >= 4U)) {
-      for (uint32_t i = 1; i < len; i++) {
-        while (!put_char(ur, data[i])) {
-          // wait
+// send on serial. every 64 byte packet starts with the ring number, so a USB packet
+// and a whole SPI transfer of concatenated packets are handled the same.
+// rings sent out by DMA don't overwrite, EP2 is held until they have room for a packet,
+// the others drop their oldest bytes
+static uart_ring *serial_write_ring(uint8_t num) {
+  uart_ring *ur = NULL;
+  if ((num < 2U) || (num >= 4U)) {
+    ur = get_ring_by_number(num);
+  }
+  return ur;
+}
+
+// all or nothing, so SPI can NACK and the host resends the same data
+bool comms_endpoint2_write(const uint8_t *data, uint32_t len) {
+  bool ret = true;
+
+  ENTER_CRITICAL();
+  for (uint32_t pos = 0U; pos < len; pos += USBPACKET_MAX_SIZE) {
+    const uart_ring *ur = serial_write_ring(data[pos]);
+    if ((ur != NULL) && (ur->dma_tx != NULL)) {
+      // this and the later packets to the same ring
+      uint32_t needed = 0U;
+      for (uint32_t p = pos; p < len; p += USBPACKET_MAX_SIZE) {
+        if (serial_write_ring(data[p]) == ur) {
+          needed += MIN(len - p, USBPACKET_MAX_SIZE) - 1U;
         }
       }
+      if (needed > tx_space(ur)) {
+        ret = false;
+      }
+    }
+  }
+
+  if (ret) {
+    for (uint32_t pos = 0U; pos < len; pos += USBPACKET_MAX_SIZE) {
+      uint32_t packet_len = MIN(len - pos, USBPACKET_MAX_SIZE);
+      uart_ring *ur = serial_write_ring(data[pos]);
+      if (ur != NULL) {
+        // misra-c2012-17.7: checked above, or an overwrite ring
+        (void)put_chars(ur, &data[pos + 1U], packet_len - 1U);
+      }
     }
   }
+  EXIT_CRITICAL();
+
+  return ret;
+}
+
+bool comms_endpoint2_ready(void) {
+  bool ret = true;
+  for (uint8_t num = 0U; num <= 4U; num++) {
+    const uart_ring *ur = serial_write_ring(num);
+    if ((ur != NULL) && (ur->dma_tx != NULL) && (tx_space(ur) < (USBPACKET_MAX_SIZE - 1U))) {
+      ret = false;
+    }
+  }
+  return ret;
+}
+
+// the serial bulk endpoint (5) drains the SOM debug ring, the other rings are read with 0xe0
+int comms_serial_read(uint8_t *data, uint32_t max_len) {
+  return get_chars(&uart_ring_som_debug, data, (uint16_t)MIN(max_len, 0xFFFFU));
 }
 
 int comms_control_handler(ControlPacket_t *req, uint8_t *resp) {
@@ -77,6 +129,17 @@ int comms_control_handler(ControlPacket_t *req, uint8_t *resp) {
 #endif
 
   switch (req->request) {
+    // **** 0xa5: get sound pipeline stats
+    case 0xa5:
+      if (sound_get_stats((sound_stats_t *)resp)) {
+        resp_len = sizeof(sound_stats_t);
+      }
+      break;
+    // **** 0xa6: get main loop idle and wake latency stats
+    case 0xa6:
+      idle_get_stats((idle_stats_t *)resp);
+      resp_len = sizeof(idle_stats_t);
+      break;
     // **** 0xa8: get microsecond timer
     case 0xa8:
       time = microsecond_timer_get();
@@ -86,6 +149,49 @@ int comms_control_handler(ControlPacket_t *req, uint8_t *resp) {
       resp[3] = ((time & 0xFF000000U) >> 24U);
       resp_len = 4U;
       break;
+    // **** 0xa9: get boot profile
+    case 0xa9:
+      if (boot_profile_valid()) {
+        (void)memcpy(resp, (uint8_t *)&boot_profile, sizeof(boot_profile_t));
+        resp_len = sizeof(boot_profile_t);
+      }
+      break;
+    // **** 0xaa: CAN core (re)initialization stats
+    case 0xaa:
+      if (req->param1 < PANDA_CAN_CNT) {
+        uint8_t can_number = CAN_NUM_FROM_BUS_NUM(req->param1);
+        (void)memcpy(resp, (uint8_t *)&can_init_stats[can_number], sizeof(can_init_stats_t));
+        resp_len = sizeof(can_init_stats_t);
+      }
+      break;
+    // **** 0xab: get cycle count probe stats, param2 resets the probe after reading
+    #ifdef PROBES_ENABLED
+    case 0xab:
+      if (req->param1 < PROBE_CNT) {
+        probe_get_stats(req->param1, (probe_stats_t *)resp, req->param2 != 0U);
+        resp_len = sizeof(probe_stats_t);
+      }
+      break;
+    #endif
+    #ifdef TRACE_ENABLED
+    // **** 0xac: start/stop the event trace, starting clears it
+    case 0xac:
+      trace_set_enabled(req->param1 != 0U);
+      break;
+    // **** 0xad: get event trace stats
+    case 0xad:
+      trace_get_stats((trace_stats_t *)resp);
+      resp_len = sizeof(trace_stats_t);
+      break;
+    #endif
+    // **** 0xae: set mic filter, param1 is the sinc order, param2 the oversampling ratio
+    case 0xae:
+      (void)mic_set_filter(req->param1, req->param2);
+      break;
+    // **** 0xaf: set mic output, param1 is the gain in 1/256 steps (0 for AGC), param2 mono
+    case 0xaf:
+      (void)mic_set_output(req->param1, req->param2 != 0U);
+      break;
     // **** 0xb0: set IR power
     case 0xb0:
       current_board->set_ir_power(req->param1);
@@ -261,10 +367,13 @@ int comms_control_handler(ControlPacket_t *req, uint8_t *resp) {
       }
 
       // read
-      uint16_t req_length = MIN(req->length, USBPACKET_MAX_SIZE);
-      while ((resp_len < req_length) &&
-                         get_char(ur, (char*)&resp[resp_len])) {
-        ++resp_len;
+      resp_len = get_chars(ur, resp, (uint16_t)MIN(req->length, USBPACKET_MAX_SIZE));
+      break;
+    // **** 0xe4: set uart baud rate, param2 is in units of 300 baud
+    case 0xe4:
+      ur = get_ring_by_number(req->param1);
+      if ((ur != NULL) && (req->param2 != 0U)) {
+        uart_set_baud(ur, (uint32_t)req->param2 * 300U);
       }
       break;
     // **** 0xe5: set CAN loopback (for testing)
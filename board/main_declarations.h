@@ -7,6 +7,7 @@ typedef struct board board;
 typedef struct harness_configuration harness_configuration;
 void pwm_init(TIM_TypeDef *TIM, uint8_t channel);
 void pwm_set(TIM_TypeDef *TIM, uint8_t channel, uint8_t percentage);
+void pwm_set_fraction(TIM_TypeDef *TIM, uint8_t channel, uint32_t num, uint32_t den);
 
 // ********************* Globals **********************
 extern uint8_t hw_type;
@@ -0,0 +1,77 @@
+#pragma once
+
+// Cycle count probes around the hot paths, read back over 0xab.
+// PROBE_BEGIN/PROBE_END bracket a block in the same scope, nesting and interrupts are fine.
+// Only built into debug builds of the panda app, everywhere else they compile to nothing.
+#define PROBE_CAN_RX 0U
+#define PROBE_PROCESS_CAN 1U
+#define PROBE_COMMS_CAN_READ 2U
+#define PROBE_COMMS_CAN_WRITE 3U
+#define PROBE_SPI_RX_DONE 4U
+#define PROBE_SAFETY_RX 5U
+#define PROBE_SAFETY_TX 6U
+#define PROBE_SOUND_RX 7U
+#define PROBE_SOUND_TX 8U
+#define PROBE_CNT 9U
+
+#define PROBE_WINDOW 16U  // min/avg/max are over this many most recent calls
+
+typedef struct __attribute__((packed)) {
+  uint32_t cnt;      // calls since boot or the last reset
+  uint32_t min;      // cycles, over the window
+  uint32_t avg;
+  uint32_t max;
+  uint32_t max_all;  // cycles, since boot or the last reset
+} probe_stats_t;
+
+#if defined(ALLOW_DEBUG) && defined(STM32H7) && !defined(BOOTSTUB) && !defined(PANDA_JUNGLE) && !defined(PANDA_BODY)
+#define PROBES_ENABLED
+
+typedef struct {
+  uint32_t cnt;
+  uint32_t max_all;
+  uint32_t window[PROBE_WINDOW];
+} probe_t;
+
+static probe_t probes[PROBE_CNT];
+
+// the cycle counter is started by boot_profile_app_start(), and never reset after
+#define PROBE_BEGIN(probe) uint32_t probe_start_##probe = DWT->CYCCNT
+#define PROBE_END(probe) probe_record((probe), DWT->CYCCNT - probe_start_##probe)
+
+void probe_record(uint8_t probe, uint32_t cycles) {
+  ENTER_CRITICAL();
+  probe_t *p = &probes[probe];
+  p->window[p->cnt % PROBE_WINDOW] = cycles;
+  p->cnt += 1U;
+  p->max_all = MAX(p->max_all, cycles);
+  EXIT_CRITICAL();
+}
+
+void probe_get_stats(uint8_t probe, probe_stats_t *stats, bool reset) {
+  ENTER_CRITICAL();
+  probe_t *p = &probes[probe];
+  uint32_t n = MIN(p->cnt, PROBE_WINDOW);
+  uint32_t sum = 0U;
+
+  stats->cnt = p->cnt;
+  stats->min = (n > 0U) ? 0xFFFFFFFFU : 0U;
+  stats->max = 0U;
+  stats->max_all = p->max_all;
+  for (uint32_t i = 0U; i < n; i++) {
+    stats->min = MIN(stats->min, p->window[i]);
+    stats->max = MAX(stats->max, p->window[i]);
+    sum += p->window[i];
+  }
+  stats->avg = (n > 0U) ? (sum / n) : 0U;
+
+  if (reset) {
+    p->cnt = 0U;
+    p->max_all = 0U;
+  }
+  EXIT_CRITICAL();
+}
+#else
+#define PROBE_BEGIN(probe)
+#define PROBE_END(probe)
+#endif
@@ -9,6 +9,7 @@
 #include "board/drivers/harness.h"
 #include "board/drivers/fan.h"
 #include "board/stm32h7/llfan.h"
+#include "board/stm32h7/sound_dsp.h"
 #include "board/stm32h7/sound.h"
 #include "board/drivers/fake_siren.h"
 #include "board/drivers/clock_source.h"
@@ -64,6 +64,275 @@ static void adc_calibrate_vdda(void) {
   print("  AVDD: 0x"); puth(adc_avdd_mV); print(" mV\n");
 }
 
+__attribute__((section(".sram12"))) static uint16_t adc1_scan_buf[ADC_SCAN_PASSES * ADC_SCAN_MAX_CHANNELS];
+__attribute__((section(".sram12"))) static uint16_t adc3_scan_buf[ADC_SCAN_PASSES * ADC_SCAN_MAX_CHANNELS];
+
+static void adc1_scan_dma_handler(void);
+static void adc3_scan_dma_handler(void);
+
+static adc_scan_t adc_scans[] = {
+  {.adc = ADC1, .dma = DMA2_Stream0, .dmamux = DMAMUX1_Channel8, .dma_request = 9U, .dma_flags = 0x3DUL, .dma_tc_flag = DMA_LISR_TCIF0,
+   .dma_irq = DMA2_Stream0_IRQn, .dma_handler = adc1_scan_dma_handler, .done = NULL, .len = 0U, .buf = adc1_scan_buf},
+  {.adc = ADC3, .dma = DMA2_Stream1, .dmamux = DMAMUX1_Channel9, .dma_request = 115U, .dma_flags = (0x3DUL << 6U), .dma_tc_flag = DMA_LISR_TCIF1,
+   .dma_irq = DMA2_Stream1_IRQn, .dma_handler = adc3_scan_dma_handler, .done = NULL, .len = 0U, .buf = adc3_scan_buf},
+};
+
+static void adc_scan_stop(adc_scan_t *scan) {
+  ADC_TypeDef *adc = scan->adc;
+  if ((adc->CR & ADC_CR_ADSTART) != 0U) {
+    adc->CR |= ADC_CR_ADSTP;
+    while ((adc->CR & ADC_CR_ADSTP) != 0U);
+  }
+  adc->CFGR &= ~(ADC_CFGR_CONT | ADC_CFGR_DMNGT);  // same bits as ADC3_CFGR_DMAEN | ADC3_CFGR_DMACFG
+  adc->ISR = ADC_ISR_EOC | ADC_ISR_EOS | ADC_ISR_OVR;
+
+  scan->dma->CR &= ~DMA_SxCR_EN;
+  while ((scan->dma->CR & DMA_SxCR_EN) != 0U);
+  DMA2->LIFCR = scan->dma_flags;
+}
+
+static void adc_scan_start(adc_scan_t *scan) {
+  ADC_TypeDef *adc = scan->adc;
+  uint32_t sqr[4] = {(uint32_t)scan->len - 1U, 0U, 0U, 0U};
+  uint32_t smpr[2] = {0U, 0U};
+  uint32_t pcsel = 0U;
+
+  for (uint8_t i = 0U; i < scan->len; i++) {
+    const adc_signal_t *signal = &scan->signals[i];
+    uint32_t rank = (uint32_t)i + 1U;  // SQ1 follows L in SQR1
+    sqr[rank / 5U] |= (uint32_t)signal->channel << ((rank % 5U) * 6U);
+    if (signal->channel < 10U) {
+      smpr[0] |= (uint32_t)signal->sample_time << (signal->channel * 3U);
+    } else {
+      smpr[1] |= (uint32_t)signal->sample_time << ((signal->channel - 10U) * 3U);
+    }
+    pcsel |= (0x1UL << signal->channel);
+  }
+
+  adc->SQR1 = sqr[0];
+  adc->SQR2 = sqr[1];
+  adc->SQR3 = sqr[2];
+  adc->SQR4 = sqr[3];
+  adc->SMPR1 = smpr[0];
+  adc->SMPR2 = smpr[1];
+  adc->PCSEL_RES0 = pcsel;
+
+  // oversampling is per ADC, the first signal sets it
+  adc_oversampling_t oversampling = scan->signals[0].oversampling;
+  adc->CFGR2 = (((1U << (uint32_t) oversampling) - 1U) << ADC_CFGR2_OVSR_Pos) | ((uint32_t) oversampling << ADC_CFGR2_OVSS_Pos);
+  adc->CFGR2 |= (oversampling != OVERSAMPLING_1) ? ADC_CFGR2_ROVSE : 0U;
+
+  // DMA (ADC -> memory, circular over all passes)
+  register_set(&scan->dmamux->CCR, scan->dma_request, DMAMUX_CxCR_DMAREQ_ID_Msk);
+  scan->dma->PAR = (uint32_t)&adc->DR;
+  scan->dma->M0AR = (uint32_t)scan->buf;
+  scan->dma->NDTR = (uint32_t)scan->len * ADC_SCAN_PASSES;
+  scan->dma->CR = (0b01UL << DMA_SxCR_MSIZE_Pos) | (0b01UL << DMA_SxCR_PSIZE_Pos) | DMA_SxCR_MINC | DMA_SxCR_CIRC;
+  scan->dma->CR |= (scan->done != NULL) ? DMA_SxCR_TCIE : 0U;
+  scan->dma->CR |= DMA_SxCR_EN;
+
+  // continuous conversions with circular DMA
+  adc->CFGR |= ADC_CFGR_CONT | ((adc == ADC3) ? (ADC3_CFGR_DMAEN | ADC3_CFGR_DMACFG) : ADC_CFGR_DMNGT);
+  adc->CR |= ADC_CR_ADSTART;
+}
+
+static uint16_t adc_scan_average(const adc_scan_t *scan, uint8_t idx) {
+  uint32_t sum = 0U;
+  for (uint32_t i = 0U; i < ADC_SCAN_PASSES; i++) {
+    sum += scan->buf[(i * scan->len) + idx];
+  }
+  return (uint16_t)(sum / ADC_SCAN_PASSES);
+}
+
+static adc_scan_t *adc_scan_find(const ADC_TypeDef *adc) {
+  adc_scan_t *ret = NULL;
+  for (uint8_t i = 0U; i < (sizeof(adc_scans) / sizeof(adc_scans[0])); i++) {
+    if (adc_scans[i].adc == adc) {
+      ret = &adc_scans[i];
+    }
+  }
+  return ret;
+}
+
+// scan->len if the channel isn't scanned
+static uint8_t adc_scan_index(const adc_scan_t *scan, uint8_t channel) {
+  uint8_t ret = scan->len;
+  for (uint8_t i = 0U; i < scan->len; i++) {
+    if (scan->signals[i].channel == channel) {
+      ret = i;
+    }
+  }
+  return ret;
+}
+
+static void adc_scan_restart(adc_scan_t *scan) {
+  if (scan->len > 0U) {
+    adc_scan_start(scan);
+  } else {
+    scan->adc->PCSEL_RES0 = 0U;
+  }
+}
+
+// Restarts a stopped scan with the signal added or removed. The other signals keep
+// their current averages, an added one starts out at value.
+static void adc_scan_update(adc_scan_t *scan, const adc_signal_t *signal, bool add, uint16_t value) {
+  uint16_t values[ADC_SCAN_MAX_CHANNELS];
+  for (uint8_t i = 0U; i < scan->len; i++) {
+    values[i] = adc_scan_average(scan, i);
+  }
+
+  uint8_t len = 0U;
+  for (uint8_t i = 0U; i < scan->len; i++) {
+    if (scan->signals[i].channel != signal->channel) {
+      scan->signals[len] = scan->signals[i];
+      values[len] = values[i];
+      len++;
+    }
+  }
+  if (add) {
+    scan->signals[len] = *signal;
+    values[len] = value;
+    len++;
+  }
+  scan->len = len;
+
+  // the buffer layout changed, seed all passes
+  for (uint32_t i = 0U; i < ADC_SCAN_PASSES; i++) {
+    for (uint8_t j = 0U; j < scan->len; j++) {
+      scan->buf[(i * scan->len) + j] = values[j];
+    }
+  }
+  // a single conversion owns the ADC, adc_scan_get_raw() restarts the scan after it
+  if (!scan->converting) {
+    adc_scan_restart(scan);
+  }
+}
+
+// Latest averaged raw reading. A signal's first read adds it to the scan of its ADC,
+// which takes one blocking conversion. ADCs without a scan always convert.
+// The conversion runs with interrupts on. The scan is stopped meanwhile, other reads get
+// the last averages, and a first read from an interrupt returns 0.
+uint16_t adc_scan_get_raw(const adc_signal_t *signal) {
+  uint16_t ret = 0U;
+  adc_scan_t *scan = adc_scan_find(signal->adc);
+
+  if (scan == NULL) {
+    ret = adc_get_raw(signal);
+  } else {
+    ENTER_CRITICAL();
+    uint8_t idx = adc_scan_index(scan, signal->channel);
+    bool convert = false;
+    if (idx < scan->len) {
+      ret = adc_scan_average(scan, idx);
+    } else if (scan->len >= ADC_SCAN_MAX_CHANNELS) {
+      if (scan->full_cnt == 0U) {
+        print("ADC scan full\n");
+      }
+      scan->full_cnt += 1U;
+    } else if (!scan->converting) {
+      adc_scan_stop(scan);
+      scan->converting = true;
+      convert = true;
+    } else {
+      // another first read is converting
+    }
+    EXIT_CRITICAL();
+
+    if (convert) {
+      ret = adc_get_raw(signal);
+
+      ENTER_CRITICAL();
+      scan->converting = false;
+      if ((adc_scan_index(scan, signal->channel) == scan->len) && (scan->len < ADC_SCAN_MAX_CHANNELS)) {
+        adc_scan_update(scan, signal, true, ret);
+      } else {
+        adc_scan_restart(scan);
+      }
+      EXIT_CRITICAL();
+    }
+  }
+
+  return ret;
+}
+
+// Adds a signal to the scan without the blocking conversion, its reads are valid once adc_scan_ready().
+// Returns false if the ADC has no scan or it's full.
+bool adc_scan_add(const adc_signal_t *signal) {
+  bool ret = false;
+  adc_scan_t *scan = adc_scan_find(signal->adc);
+  if ((scan != NULL) && (scan->len < ADC_SCAN_MAX_CHANNELS)) {
+    ENTER_CRITICAL();
+    if (adc_scan_index(scan, signal->channel) == scan->len) {
+      if (!scan->converting) {
+        adc_scan_stop(scan);
+      }
+      adc_scan_update(scan, signal, true, 0U);
+    }
+    EXIT_CRITICAL();
+    ret = true;
+  }
+  return ret;
+}
+
+// Stops converting the signal, this also disconnects the pin from the ADC
+void adc_scan_remove(const adc_signal_t *signal) {
+  adc_scan_t *scan = adc_scan_find(signal->adc);
+  if (scan != NULL) {
+    ENTER_CRITICAL();
+    if (adc_scan_index(scan, signal->channel) < scan->len) {
+      if (!scan->converting) {
+        adc_scan_stop(scan);
+      }
+      adc_scan_update(scan, signal, false, 0U);
+    }
+    EXIT_CRITICAL();
+  }
+}
+
+// True once every pass in the buffer has been converted since the scan was last changed
+bool adc_scan_ready(const ADC_TypeDef *adc) {
+  const adc_scan_t *scan = adc_scan_find(adc);
+  return (scan == NULL) || ((DMA2->LISR & scan->dma_tc_flag) != 0U);
+}
+
+static void adc_scan_dma_handler(adc_scan_t *scan) {
+  // the transfer complete flag stays set for adc_scan_ready(), one interrupt per callback
+  scan->dma->CR &= ~DMA_SxCR_TCIE;
+  void (*done)(void) = scan->done;
+  scan->done = NULL;
+  if (done != NULL) {
+    done();
+  }
+}
+
+static void adc1_scan_dma_handler(void) {
+  adc_scan_dma_handler(&adc_scans[0]);
+}
+
+static void adc3_scan_dma_handler(void) {
+  adc_scan_dma_handler(&adc_scans[1]);
+}
+
+// Calls done once from the scan's DMA interrupt, as soon as adc_scan_ready(). NULL cancels.
+void adc_scan_notify(const ADC_TypeDef *adc, void (*done)(void)) {
+  adc_scan_t *scan = adc_scan_find(adc);
+  if (scan != NULL) {
+    ENTER_CRITICAL();
+    if (interrupts[scan->dma_irq].handler != scan->dma_handler) {
+      REGISTER_INTERRUPT(scan->dma_irq, scan->dma_handler, ADC_SCAN_DONE_RATE, FAULT_INTERRUPT_RATE_INTERRUPTS)
+      NVIC_EnableIRQ(scan->dma_irq);
+    }
+    scan->done = done;
+    // fires right away if the scan is already done
+    if (done != NULL) {
+      scan->dma->CR |= DMA_SxCR_TCIE;
+    } else {
+      scan->dma->CR &= ~DMA_SxCR_TCIE;
+    }
+    EXIT_CRITICAL();
+  }
+}
+
 uint16_t adc_get_mV(const adc_signal_t *signal) {
   uint16_t ret = 0;
 
@@ -72,9 +341,9 @@ uint16_t adc_get_mV(const adc_signal_t *signal) {
   }
 
   if ((signal->adc == ADC1) || (signal->adc == ADC2)) {
-    ret = (adc_get_raw(signal) * adc_avdd_mV) / 65535U;
+    ret = (adc_scan_get_raw(signal) * adc_avdd_mV) / 65535U;
   } else if (signal->adc == ADC3) {
-    ret = (adc_get_raw(signal) * adc_avdd_mV) / 4095U;
+    ret = (adc_scan_get_raw(signal) * adc_avdd_mV) / 4095U;
   } else {}
   return ret;
 }
@@ -35,3 +35,26 @@ typedef struct {
 #define ADC_CHANNEL_DEFAULT(a, c) {.adc = (a), .channel = (c), .sample_time = SAMPLETIME_32_CYCLES, .oversampling = OVERSAMPLING_64}
 
 #define VREFINT_CAL_ADDR ((uint16_t *)0x1FF1E860UL)
+
+// Background scan: adc_get_mV() reads of ADC1 and ADC3 come from a continuous DMA scan of all the
+// channels read so far, averaged over the last ADC_SCAN_PASSES passes. Don't use adc_get_raw() on those.
+#define ADC_SCAN_MAX_CHANNELS 16U
+#define ADC_SCAN_PASSES 8U
+#define ADC_SCAN_DONE_RATE 16U  // adc_scan_notify() callbacks per second
+
+typedef struct {
+  ADC_TypeDef *adc;
+  DMA_Stream_TypeDef *dma;
+  DMAMUX_Channel_TypeDef *dmamux;
+  uint8_t dma_request;
+  uint32_t dma_flags;  // in DMA2->LIFCR
+  uint32_t dma_tc_flag;
+  IRQn_Type dma_irq;
+  void (*dma_handler)(void);
+  void (*done)(void);  // see adc_scan_notify()
+  uint8_t len;
+  adc_signal_t signals[ADC_SCAN_MAX_CHANNELS];
+  uint16_t *buf;       // [pass][signal]
+  bool converting;     // stopped for a single conversion, see adc_scan_get_raw()
+  uint32_t full_cnt;   // reads of signals that didn't fit in the scan
+} adc_scan_t;
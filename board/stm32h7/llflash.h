@@ -7,27 +7,45 @@ void flash_unlock(void) {
   FLASH->KEYR1 = 0xCDEF89AB;
 }
 
-bool flash_erase_sector(uint8_t sector, bool unlocked) {
+// starts the erase and returns, completion is signaled by QW clearing
+bool flash_erase_sector_start(uint8_t sector, bool unlocked) {
   // don't erase the bootloader(sector 0)
   if (sector != 0 && sector < 8 && unlocked) {
     FLASH->CR1 = (sector << 8) | FLASH_CR_SER;
     FLASH->CR1 |= FLASH_CR_START;
-    while (FLASH->SR1 & FLASH_SR_QW);
     return true;
   }
   return false;
 }
 
-void flash_write_word(void *prog_ptr, uint32_t data) {
-  uint32_t *pp = prog_ptr;
-  FLASH->CR1 |= FLASH_CR_PG;
-  *pp = data;
+bool flash_erase_sector(uint8_t sector, bool unlocked) {
+  bool ret = flash_erase_sector_start(sector, unlocked);
+  while (FLASH->SR1 & FLASH_SR_QW);
+  return ret;
+}
+
+bool flash_busy(void) {
+  return (FLASH->SR1 & FLASH_SR_QW) != 0U;
+}
+
+// H7 flash is programmed in 256-bit flash words
+#define FLASH_WORD_WORDS 8U
+
+// Fills the write buffer with len words (a full flash word starts programming
+// by itself). Only the previous flash word is waited on instead of spinning on
+// each one right after writing it. Code fetched from the bank stalls until the
+// programming is done, so this saves the polling, it doesn't run in parallel.
+void flash_write_words(uint32_t *prog_ptr, const uint32_t *data, uint32_t len) {
   while (FLASH->SR1 & FLASH_SR_QW);
+  FLASH->CR1 |= FLASH_CR_PG;
+  for (uint32_t i = 0U; i < len; i++) {
+    prog_ptr[i] = data[i];
+  }
 }
 
 void flush_write_buffer(void) {
   if (FLASH->SR1 & FLASH_SR_WBNE) {
     FLASH->CR1 |= FLASH_CR_FW;
-    while (FLASH->SR1 & FLASH_CR_FW);
   }
+  while (FLASH->SR1 & FLASH_SR_QW);
 }
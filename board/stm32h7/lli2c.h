@@ -1,14 +1,48 @@
-// TODO: this driver relies heavily on polling,
-// if we want it to be more async, we should use interrupts
+// Interrupt driven I2C master. Register transactions are queued per bus and run
+// from the event/error interrupts, so nothing here waits on the bus.
+// Callbacks are called from the I2C interrupt once a transaction is done or has run out of retries,
+// value is the register value for reads.
 
 #define I2C_RETRY_COUNT 10U
 #define I2C_TIMEOUT_US 100000U
+#define I2C_QUEUE_SIZE 16U
+#define I2C_IRQ_RATE 20000U  // ~1 per byte at 100kHz, with some margin
 
-bool i2c_status_wait(const volatile uint32_t *reg, uint32_t mask, uint32_t val) {
-  uint32_t start_time = microsecond_timer_get();
-  while(((*reg & mask) != val) && (get_ts_elapsed(microsecond_timer_get(), start_time) < I2C_TIMEOUT_US));
-  return ((*reg & mask) == val);
-}
+#define I2C_OP_WRITE 0U
+#define I2C_OP_READ 1U
+#define I2C_OP_SET_MASK 2U  // read-modify-write
+
+#define I2C_PHASE_WRITE 0U
+#define I2C_PHASE_READ_REG 1U
+#define I2C_PHASE_READ_DATA 2U
+
+#define I2C_ICR_ALL (I2C_ICR_STOPCF | I2C_ICR_NACKCF | I2C_ICR_BERRCF | I2C_ICR_ARLOCF | I2C_ICR_OVRCF)
+
+typedef void (*i2c_callback)(bool success, uint8_t value);
+
+typedef struct {
+  uint8_t op;
+  uint8_t addr;
+  uint8_t reg;
+  uint8_t value;
+  uint8_t mask;
+  i2c_callback callback;
+} i2c_transaction_t;
+
+typedef struct {
+  I2C_TypeDef *I2C;
+  i2c_transaction_t queue[I2C_QUEUE_SIZE];
+  uint8_t w_ptr;
+  uint8_t r_ptr;
+  bool busy;
+  uint8_t phase;
+  uint8_t tx_buf[2];
+  uint8_t tx_idx;
+  uint8_t read_value;
+  uint8_t retries;
+  uint32_t start_ts;
+  uint32_t failures;
+} i2c_bus_t;
 
 void i2c_reset(I2C_TypeDef *I2C) {
   // peripheral reset
@@ -17,151 +51,159 @@ void i2c_reset(I2C_TypeDef *I2C) {
   register_set_bits(&I2C->CR1, I2C_CR1_PE);
 }
 
-bool i2c_write_reg(I2C_TypeDef *I2C, uint8_t addr, uint8_t reg, uint8_t value) {
-  bool ret = false;
+static uint32_t i2c_sadd(uint8_t addr) {
+  return ((uint32_t)addr << 1U) & I2C_CR2_SADD_Msk;
+}
 
-  // Setup transfer and send START + addr
-  for (uint32_t i = 0U; i < I2C_RETRY_COUNT; i++) {
-    register_clear_bits(&I2C->CR2, I2C_CR2_ADD10);
-    I2C->CR2 = ((uint32_t)addr << 1U) & I2C_CR2_SADD_Msk;
-    register_clear_bits(&I2C->CR2, I2C_CR2_RD_WRN);
-    register_set_bits(&I2C->CR2, I2C_CR2_AUTOEND);
-    I2C->CR2 |= 2UL << I2C_CR2_NBYTES_Pos;
-
-    I2C->CR2 |= I2C_CR2_START;
-    if(!i2c_status_wait(&I2C->CR2, I2C_CR2_START, 0U)) {
-      continue;
-    }
+static void i2c_start_write(i2c_bus_t *bus, uint8_t value) {
+  const i2c_transaction_t *t = &bus->queue[bus->r_ptr];
+  bus->phase = I2C_PHASE_WRITE;
+  bus->tx_buf[0] = t->reg;
+  bus->tx_buf[1] = value;
+  bus->tx_idx = 0U;
+  bus->I2C->CR2 = i2c_sadd(t->addr) | (2UL << I2C_CR2_NBYTES_Pos) | I2C_CR2_AUTOEND | I2C_CR2_START;
+}
 
-    // check if we lost arbitration
-    if ((I2C->ISR & I2C_ISR_ARLO) != 0U) {
-      register_set_bits(&I2C->ICR, I2C_ICR_ARLOCF);
-    } else {
-      ret = true;
-      break;
-    }
+static void i2c_start_transaction(i2c_bus_t *bus) {
+  const i2c_transaction_t *t = &bus->queue[bus->r_ptr];
+  bus->start_ts = microsecond_timer_get();
+  if (t->op == I2C_OP_WRITE) {
+    i2c_start_write(bus, t->value);
+  } else {
+    // register address without a stop, the read follows with a restart on TC
+    bus->phase = I2C_PHASE_READ_REG;
+    bus->tx_buf[0] = t->reg;
+    bus->tx_idx = 0U;
+    bus->I2C->CR2 = i2c_sadd(t->addr) | (1UL << I2C_CR2_NBYTES_Pos) | I2C_CR2_START;
   }
+}
 
-  if (!ret) {
-    goto end;
+// retries or ends the current transaction, then starts the next queued one
+static void i2c_next(i2c_bus_t *bus, bool success) {
+  if (!success) {
+    i2c_reset(bus->I2C);
   }
 
-  // Send data
-  ret = i2c_status_wait(&I2C->ISR, I2C_ISR_TXIS, I2C_ISR_TXIS);
-  if(!ret) {
-    goto end;
-  }
-  I2C->TXDR = reg;
+  if (!success && (bus->retries < I2C_RETRY_COUNT)) {
+    // a read-modify-write restarts with the read
+    bus->retries++;
+    i2c_start_transaction(bus);
+  } else {
+    i2c_callback callback = bus->queue[bus->r_ptr].callback;
+    if (!success) {
+      bus->failures++;
+    }
 
-  ret = i2c_status_wait(&I2C->ISR, I2C_ISR_TXIS, I2C_ISR_TXIS);
-  if(!ret) {
-    goto end;
-  }
-  I2C->TXDR = value;
+    bus->r_ptr = (bus->r_ptr + 1U) % I2C_QUEUE_SIZE;
+    bus->retries = 0U;
+    bus->busy = (bus->r_ptr != bus->w_ptr);
+    if (bus->busy) {
+      i2c_start_transaction(bus);
+    }
 
-end:
-  return ret;
+    if (callback != NULL) {
+      callback(success, bus->read_value);
+    }
+  }
 }
 
-bool i2c_read_reg(I2C_TypeDef *I2C, uint8_t addr, uint8_t reg, uint8_t *value) {
-  bool ret = false;
-
-  // Setup transfer and send START + addr
-  for (uint32_t i = 0U; i < I2C_RETRY_COUNT; i++) {
-    register_clear_bits(&I2C->CR2, I2C_CR2_ADD10);
-    I2C->CR2 = ((uint32_t)addr << 1U) & I2C_CR2_SADD_Msk;
-    register_clear_bits(&I2C->CR2, I2C_CR2_RD_WRN);
-    register_clear_bits(&I2C->CR2, I2C_CR2_AUTOEND);
-    I2C->CR2 |= 1UL << I2C_CR2_NBYTES_Pos;
-
-    I2C->CR2 |= I2C_CR2_START;
-    if(!i2c_status_wait(&I2C->CR2, I2C_CR2_START, 0U)) {
-      continue;
+// hook up to both the event and the error interrupt of the bus
+void i2c_irq_handler(i2c_bus_t *bus) {
+  I2C_TypeDef *I2C = bus->I2C;
+  uint32_t isr = I2C->ISR;
+
+  if (!bus->busy) {
+    I2C->ICR = I2C_ICR_ALL;
+  } else if ((isr & (I2C_ISR_NACKF | I2C_ISR_ARLO | I2C_ISR_BERR)) != 0U) {
+    I2C->ICR = I2C_ICR_ALL;
+    i2c_next(bus, false);
+  } else if ((isr & I2C_ISR_TXIS) != 0U) {
+    I2C->TXDR = bus->tx_buf[bus->tx_idx];
+    if (bus->tx_idx == 0U) {
+      bus->tx_idx = 1U;
     }
-
-    // check if we lost arbitration
-    if ((I2C->ISR & I2C_ISR_ARLO) != 0U) {
-      register_set_bits(&I2C->ICR, I2C_ICR_ARLOCF);
+  } else if ((isr & I2C_ISR_RXNE) != 0U) {
+    bus->read_value = I2C->RXDR;
+  } else if ((isr & I2C_ISR_TC) != 0U) {
+    // register address sent, restart for the read
+    const i2c_transaction_t *t = &bus->queue[bus->r_ptr];
+    bus->phase = I2C_PHASE_READ_DATA;
+    I2C->CR2 = i2c_sadd(t->addr) | (1UL << I2C_CR2_NBYTES_Pos) | I2C_CR2_RD_WRN | I2C_CR2_AUTOEND | I2C_CR2_START;
+  } else if ((isr & I2C_ISR_STOPF) != 0U) {
+    I2C->ICR = I2C_ICR_STOPCF;
+    const i2c_transaction_t *t = &bus->queue[bus->r_ptr];
+    if ((t->op == I2C_OP_SET_MASK) && (bus->phase == I2C_PHASE_READ_DATA)) {
+      i2c_start_write(bus, (bus->read_value & (uint8_t)(~t->mask)) | (t->value & t->mask));
     } else {
-      ret = true;
-      break;
+      i2c_next(bus, true);
     }
+  } else {
+    // nothing to do
   }
+}
 
-  if (!ret) {
-    goto end;
-  }
-
-  // Send data
-  ret = i2c_status_wait(&I2C->ISR, I2C_ISR_TXIS, I2C_ISR_TXIS);
-  if(!ret) {
-    goto end;
-  }
-  I2C->TXDR = reg;
-
-  // Restart
-  I2C->CR2 = (((addr << 1) | 0x1U) & I2C_CR2_SADD_Msk) | (1UL << I2C_CR2_NBYTES_Pos) | I2C_CR2_RD_WRN | I2C_CR2_START;
-  ret = i2c_status_wait(&I2C->CR2, I2C_CR2_START, 0U);
-  if(!ret) {
-    goto end;
+// a stuck bus doesn't interrupt, call this periodically to time out the current transaction
+void i2c_tick(i2c_bus_t *bus) {
+  ENTER_CRITICAL();
+  if (bus->busy && (get_ts_elapsed(microsecond_timer_get(), bus->start_ts) > I2C_TIMEOUT_US)) {
+    i2c_next(bus, false);
   }
+  EXIT_CRITICAL();
+}
 
-  // check if we lost arbitration
-  if ((I2C->ISR & I2C_ISR_ARLO) != 0U) {
-    register_set_bits(&I2C->ICR, I2C_ICR_ARLOCF);
-    ret = false;
-    goto end;
-  }
+// returns false if the queue is full
+bool i2c_queue(i2c_bus_t *bus, uint8_t op, uint8_t addr, uint8_t reg, uint8_t value, uint8_t mask, i2c_callback callback) {
+  bool ret = false;
 
-  // Read data
-  ret = i2c_status_wait(&I2C->ISR, I2C_ISR_RXNE, I2C_ISR_RXNE);
-  if(!ret) {
-    goto end;
+  ENTER_CRITICAL();
+  uint8_t next_w_ptr = (bus->w_ptr + 1U) % I2C_QUEUE_SIZE;
+  if (next_w_ptr != bus->r_ptr) {
+    i2c_transaction_t *t = &bus->queue[bus->w_ptr];
+    t->op = op;
+    t->addr = addr;
+    t->reg = reg;
+    t->value = value;
+    t->mask = mask;
+    t->callback = callback;
+    bus->w_ptr = next_w_ptr;
+
+    if (!bus->busy) {
+      bus->busy = true;
+      bus->retries = 0U;
+      i2c_start_transaction(bus);
+    }
+    ret = true;
   }
-  *value = I2C->RXDR;
+  EXIT_CRITICAL();
 
-  // Stop
-  I2C->CR2 |= I2C_CR2_STOP;
-
-end:
+  return ret;
+}
 
-  if (!ret) {
-    i2c_reset(I2C);
-  }
+bool i2c_write_reg(i2c_bus_t *bus, uint8_t addr, uint8_t reg, uint8_t value, i2c_callback callback) {
+  return i2c_queue(bus, I2C_OP_WRITE, addr, reg, value, 0xFFU, callback);
+}
 
-  return ret;
+bool i2c_read_reg(i2c_bus_t *bus, uint8_t addr, uint8_t reg, i2c_callback callback) {
+  return i2c_queue(bus, I2C_OP_READ, addr, reg, 0U, 0U, callback);
 }
 
-bool i2c_set_reg_bits(I2C_TypeDef *I2C, uint8_t address, uint8_t regis, uint8_t bits) {
-  uint8_t value;
-  bool ret = i2c_read_reg(I2C, address, regis, &value);
-  if(ret) {
-    ret = i2c_write_reg(I2C, address, regis, value | bits);
-  }
-  return ret;
+bool i2c_set_reg_bits(i2c_bus_t *bus, uint8_t address, uint8_t regis, uint8_t bits, i2c_callback callback) {
+  return i2c_queue(bus, I2C_OP_SET_MASK, address, regis, bits, bits, callback);
 }
 
-bool i2c_clear_reg_bits(I2C_TypeDef *I2C, uint8_t address, uint8_t regis, uint8_t bits) {
-  uint8_t value;
-  bool ret = i2c_read_reg(I2C, address, regis, &value);
-  if (ret) {
-    ret = i2c_write_reg(I2C, address, regis, value & (uint8_t) (~bits));
-  }
-  return ret;
+bool i2c_clear_reg_bits(i2c_bus_t *bus, uint8_t address, uint8_t regis, uint8_t bits, i2c_callback callback) {
+  return i2c_queue(bus, I2C_OP_SET_MASK, address, regis, 0U, bits, callback);
 }
 
-bool i2c_set_reg_mask(I2C_TypeDef *I2C, uint8_t address, uint8_t regis, uint8_t value, uint8_t mask) {
-  uint8_t old_value;
-  bool ret = i2c_read_reg(I2C, address, regis, &old_value);
-  if(ret) {
-    ret = i2c_write_reg(I2C, address, regis, (old_value & (uint8_t) (~mask)) | (value & mask));
-  }
-  return ret;
+bool i2c_set_reg_mask(i2c_bus_t *bus, uint8_t address, uint8_t regis, uint8_t value, uint8_t mask, i2c_callback callback) {
+  return i2c_queue(bus, I2C_OP_SET_MASK, address, regis, value, mask, callback);
 }
 
-void i2c_init(I2C_TypeDef *I2C) {
+// the bus' interrupts have to be registered and enabled by the caller
+void i2c_init(i2c_bus_t *bus) {
   // 100kHz clock speed
-  I2C->TIMINGR = 0x107075B0;
+  bus->I2C->TIMINGR = 0x107075B0;
 
-  i2c_reset(I2C);
+  i2c_reset(bus->I2C);
+  register_set_bits(&bus->I2C->CR1, I2C_CR1_TXIE | I2C_CR1_RXIE | I2C_CR1_TCIE | I2C_CR1_STOPIE | I2C_CR1_NACKIE | I2C_CR1_ERRIE);
 }
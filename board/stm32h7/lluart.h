@@ -24,10 +24,57 @@ static void uart_rx_ring(uart_ring *q){
   EXIT_CRITICAL();
 }
 
+// DMA mode: RX is written straight into elems_rx in circular mode, w_ptr_rx follows the DMA counter.
+// Called on idle line and on the half/full transfer interrupts, so it runs at least every half buffer.
+static void uart_dma_rx_update(uart_ring *q) {
+  ENTER_CRITICAL();
+  uint16_t size = (uint16_t)q->rx_fifo_size;
+  uint16_t w_ptr = (uint16_t)((q->rx_fifo_size - q->dma_rx->NDTR) % q->rx_fifo_size);
+  uint16_t received = (uint16_t)((w_ptr + size - q->w_ptr_rx) % size);
+
+  if (received != 0U) {
+    uint16_t used = (uint16_t)((q->w_ptr_rx + size - q->r_ptr_rx) % size);
+    if ((used + received) >= size) {
+      // the DMA already wrote over the oldest bytes
+      q->r_ptr_rx = (w_ptr + 1U) % size;
+    }
+    q->w_ptr_rx = w_ptr;
+
+    if (q->callback != NULL) {
+      q->callback(q);
+    }
+  }
+  EXIT_CRITICAL();
+}
+
+// DMA mode: TX sends the contiguous part of the ring from r_ptr_tx, r_ptr_tx moves on completion
+static void uart_dma_tx_start(uart_ring *q) {
+  if ((q->tx_dma_len == 0U) && (q->w_ptr_tx != q->r_ptr_tx)) {
+    uint16_t len = (q->w_ptr_tx > q->r_ptr_tx) ? (q->w_ptr_tx - q->r_ptr_tx) : ((uint16_t)q->tx_fifo_size - q->r_ptr_tx);
+    q->tx_dma_len = len;
+    q->dma_tx->M0AR = (uint32_t)&q->elems_tx[q->r_ptr_tx];
+    q->dma_tx->NDTR = len;
+    q->dma_tx->CR |= DMA_SxCR_EN;
+  }
+}
+
+static void uart_dma_tx_done(uart_ring *q) {
+  ENTER_CRITICAL();
+  q->r_ptr_tx = (q->r_ptr_tx + q->tx_dma_len) % q->tx_fifo_size;
+  q->tx_dma_len = 0U;
+  uart_dma_tx_start(q);
+  EXIT_CRITICAL();
+
+  // serial writes on EP2 wait for room in DMA rings
+  comms_endpoint2_resume_usb();
+}
+
 void uart_tx_ring(uart_ring *q){
   ENTER_CRITICAL();
-  // Send out next byte of TX buffer
-  if (q->w_ptr_tx != q->r_ptr_tx) {
+  if (q->dma_tx != NULL) {
+    uart_dma_tx_start(q);
+  } else if (q->w_ptr_tx != q->r_ptr_tx) {
+    // Send out next byte of TX buffer
     // Only send if transmit register is empty (aka last byte has been sent)
     if ((q->uart->ISR & USART_ISR_TXE_TXFNF) != 0U) {
       q->uart->TDR = q->elems_tx[q->r_ptr_tx];   // This clears TXE
@@ -53,10 +100,16 @@ static void uart_interrupt_handler(uart_ring *q) {
   // Read UART status. This is also the first step necessary in clearing most interrupts
   uint32_t status = q->uart->ISR;
 
-  // If RXFNE is set, perform a read. This clears RXFNE, ORE, IDLE, NF and FE
-  if((status & USART_ISR_RXNE_RXFNE) != 0U){
+  if (q->dma_rx != NULL) {
+    // DMA mode: only idle line is enabled, pick up what the DMA got so far
+    if ((status & USART_ISR_IDLE) != 0U) {
+      q->uart->ICR = USART_ICR_IDLECF;
+      uart_dma_rx_update(q);
+    }
+  } else if ((status & USART_ISR_RXNE_RXFNE) != 0U) {
+    // If RXFNE is set, perform a read. This clears RXFNE, ORE, IDLE, NF and FE
     uart_rx_ring(q);
-  }
+  } else {}
 
   // Detect errors and clear them
   uint32_t err = (status & USART_ISR_ORE) | (status & USART_ISR_NE) | (status & USART_ISR_FE) | (status & USART_ISR_PE);
@@ -64,7 +117,10 @@ static void uart_interrupt_handler(uart_ring *q) {
     #ifdef DEBUG_UART
       print("Encountered UART error: "); puth(err); print("\n");
     #endif
-    UART_READ_RDR(q->uart)
+    // in DMA mode RDR belongs to the DMA
+    if (q->dma_rx == NULL) {
+      UART_READ_RDR(q->uart)
+    }
   }
 
   if ((err & USART_ISR_ORE) != 0U) {
@@ -85,16 +141,65 @@ static void uart_interrupt_handler(uart_ring *q) {
 
 static void UART7_IRQ_Handler(void) { uart_interrupt_handler(&uart_ring_som_debug); }
 
+// UART7 RX on DMA1 stream 2, TX on stream 3
+#define UART7_DMA_RX_FLAGS (0x3DUL << 16U)
+#define UART7_DMA_TX_FLAGS (0x3DUL << 22U)
+
+static void DMA1_Stream2_IRQ_Handler(void) {
+  DMA1->LIFCR = UART7_DMA_RX_FLAGS;
+  uart_dma_rx_update(&uart_ring_som_debug);
+}
+
+static void DMA1_Stream3_IRQ_Handler(void) {
+  DMA1->LIFCR = UART7_DMA_TX_FLAGS;
+  uart_dma_tx_done(&uart_ring_som_debug);
+}
+
+static void uart7_dma_init(uart_ring *q) {
+  q->dma_rx = DMA1_Stream2;
+  q->dma_tx = DMA1_Stream3;
+  DMA1->LIFCR = UART7_DMA_RX_FLAGS | UART7_DMA_TX_FLAGS;
+
+  // RX: circular over the whole ring, interrupts at half and full
+  register_set(&DMAMUX1_Channel2->CCR, 79U, DMAMUX_CxCR_DMAREQ_ID_Msk); // UART7_RX
+  q->dma_rx->PAR = (uint32_t)&q->uart->RDR;
+  q->dma_rx->M0AR = (uint32_t)q->elems_rx;
+  q->dma_rx->NDTR = q->rx_fifo_size;
+  q->dma_rx->CR = DMA_SxCR_MINC | DMA_SxCR_CIRC | DMA_SxCR_HTIE | DMA_SxCR_TCIE;
+  q->dma_rx->CR |= DMA_SxCR_EN;
+
+  // TX: memory -> peripheral, started per chunk
+  register_set(&DMAMUX1_Channel3->CCR, 80U, DMAMUX_CxCR_DMAREQ_ID_Msk); // UART7_TX
+  q->dma_tx->PAR = (uint32_t)&q->uart->TDR;
+  q->dma_tx->CR = DMA_SxCR_MINC | (0b01UL << DMA_SxCR_DIR_Pos) | DMA_SxCR_TCIE;
+
+  REGISTER_INTERRUPT(DMA1_Stream2_IRQn, DMA1_Stream2_IRQ_Handler, 1000U, FAULT_INTERRUPT_RATE_UART_7)
+  REGISTER_INTERRUPT(DMA1_Stream3_IRQn, DMA1_Stream3_IRQ_Handler, 1000U, FAULT_INTERRUPT_RATE_UART_7)
+  NVIC_EnableIRQ(DMA1_Stream2_IRQn);
+  NVIC_EnableIRQ(DMA1_Stream3_IRQn);
+}
+
+void uart_set_baud(uart_ring *q, uint32_t baud) {
+  if (q->uart == UART7) {
+    // UART7 is connected to APB1 at 60MHz, BRR can only be written while disabled
+    ENTER_CRITICAL();
+    register_clear_bits(&q->uart->CR1, USART_CR1_UE);
+    q->uart->BRR = 60000000U / baud;
+    register_set_bits(&q->uart->CR1, USART_CR1_UE);
+    EXIT_CRITICAL();
+  }
+}
+
 void uart_init(uart_ring *q, unsigned int baud) {
   if (q->uart == UART7) {
+    // with DMA, the UART interrupt is only for idle line and errors
     REGISTER_INTERRUPT(UART7_IRQn, UART7_IRQ_Handler, 150000U, FAULT_INTERRUPT_RATE_UART_7)
 
     // UART7 is connected to APB1 at 60MHz
     q->uart->BRR = 60000000U / baud;
-    q->uart->CR1 = USART_CR1_UE | USART_CR1_TE | USART_CR1_RE;
-
-    // Enable interrupt on RX not empty
-    q->uart->CR1 |= USART_CR1_RXNEIE;
+    q->uart->CR3 = USART_CR3_DMAR | USART_CR3_DMAT;
+    uart7_dma_init(q);
+    q->uart->CR1 = USART_CR1_UE | USART_CR1_TE | USART_CR1_RE | USART_CR1_IDLEIE;
 
     // Enable UART interrupts
     NVIC_EnableIRQ(UART7_IRQn);
@@ -2,39 +2,79 @@
 #define SOUND_TX_BUF_SIZE (SOUND_RX_BUF_SIZE/2U)
 #define MIC_RX_BUF_SIZE 512U
 #define MIC_TX_BUF_SIZE (MIC_RX_BUF_SIZE * 2U)
-__attribute__((section(".sram4"))) static uint16_t sound_rx_buf[2][SOUND_RX_BUF_SIZE];
-__attribute__((section(".sram4"))) static uint16_t sound_tx_buf[2][SOUND_TX_BUF_SIZE];
-__attribute__((section(".sram4"))) static uint32_t mic_rx_buf[2][MIC_RX_BUF_SIZE];
-__attribute__((section(".sram4"))) static uint16_t mic_tx_buf[2][MIC_TX_BUF_SIZE];
+// word aligned for the kernels in sound_dsp.h
+__attribute__((section(".sram4"), aligned(4))) static uint16_t sound_rx_buf[2][SOUND_RX_BUF_SIZE];
+__attribute__((section(".sram4"), aligned(4))) static uint16_t sound_tx_buf[2][SOUND_TX_BUF_SIZE];
+__attribute__((section(".sram4"), aligned(4))) static uint32_t mic_rx_buf[2][MIC_RX_BUF_SIZE];
+__attribute__((section(".sram4"), aligned(4))) static uint16_t mic_tx_buf[2][MIC_TX_BUF_SIZE];
 
 #define SOUND_IDLE_TIMEOUT 4U
 #define MIC_SKIP_BUFFERS 2U // Skip first 2 buffers (1024 samples = ~21ms at 48kHz)
 static uint8_t sound_idle_count;
 static uint8_t mic_idle_count;
 static uint8_t mic_buffer_count;
+static volatile bool sound_rx_ready;
+static volatile uint8_t sound_rx_ready_buf;
+static bool sound_initialized = false;
+static uint8_t mic_shift_up = 0U;  // see mic_filter_shift_up()
 uint16_t sound_output_level;
 
+// Mic pipeline: DFSDM sinc filter -> optional gain/AGC -> SAI4_A, stereo or mono slot.
+// The PDM clock divider follows the oversampling ratio to keep the output at ~48kHz, the SAI frame rate.
+#define MIC_ORDER_DEFAULT 4U
+#define MIC_OVERSAMPLING_DEFAULT 55U
+#define MIC_CLK_DIV_X_OVERSAMPLING 5005U  // 240MHz / 5005 = 47.95kHz
+#define MIC_FULL_SCALE 9150625U           // 55^4, the sinc4 x55 gain, other filters are shifted to this
+#define MIC_GAIN_UNITY 256U               // gain in 1/256 steps
+#define MIC_GAIN_MAX (MIC_GAIN_UNITY * 16U)
+#define MIC_AGC_TARGET 0x4000U            // peak the AGC aims for
+
+typedef struct __attribute__((packed)) {
+  uint8_t mic_order;
+  uint8_t mic_oversampling;
+  uint16_t mic_gain;             // 1/256 steps, tracks the AGC when it's on
+  uint8_t mic_agc;
+  uint8_t mic_mono;
+  uint16_t mic_peak;             // after the gain, 0 when it's bypassed
+  uint32_t mic_cycles;           // CPU cycles spent on the last buffer, ~10.7ms of audio
+  uint32_t mic_cycles_max;
+  uint32_t playback_cycles;      // same for the playback conversion
+  uint32_t playback_cycles_max;
+} sound_stats_t;
+
+static sound_stats_t sound_stats = {
+  .mic_order = MIC_ORDER_DEFAULT, .mic_oversampling = MIC_OVERSAMPLING_DEFAULT, .mic_gain = MIC_GAIN_UNITY,
+};
+
+#define SOUND_DAC_IRQ_PRIORITY 8U // everything else runs at 0
+
 void sound_tick(void) {
   if (sound_idle_count > 0U) {
     sound_idle_count--;
     if (sound_idle_count == 0U) {
       current_board->set_amp_enabled(false);
-      register_clear_bits(&DMA1_Stream1->CR, DMA_SxCR_EN);
       sound_output_level = 0U;
     }
   }
 
+  // no audio from the SOM, stop the mic and the DAC
   if (mic_idle_count > 0U) {
     mic_idle_count--;
     if (mic_idle_count == 0U) {
       register_clear_bits(&DFSDM1_Channel0->CHCFGR1, DFSDM_CHCFGR1_DFSDMEN);
       mic_buffer_count = 0U;
+
+      // the fake siren drives the DAC without the TC interrupt, leave it alone
+      if ((DMA1_Stream1->CR & DMA_SxCR_TCIE) != 0U) {
+        register_clear_bits(&DMA1_Stream1->CR, DMA_SxCR_EN);
+      }
     }
   }
 }
 
 // Recording processing
 static void DMA1_Stream0_IRQ_Handler(void) {
+  uint32_t start = DWT->CYCCNT;
   DMA1->LIFCR |= 0x7DU; // clear flags
 
   uint8_t tx_buf_idx = (((BDMA_Channel1->CCR & BDMA_CCR_CT) >> BDMA_CCR_CT_Pos) == 1U) ? 0U : 1U;
@@ -42,85 +82,109 @@ static void DMA1_Stream0_IRQ_Handler(void) {
   if (mic_buffer_count < MIC_SKIP_BUFFERS) {
     // Send silence during settling
     mic_buffer_count++;
-    for (uint16_t i = 0U; i < MIC_TX_BUF_SIZE; i++) {
-      mic_tx_buf[tx_buf_idx][i] = 0U;
-    }
+    sound_fill(mic_tx_buf[tx_buf_idx], 0U, MIC_TX_BUF_SIZE);
   } else {
     // process samples
     uint8_t buf_idx = (((DMA1_Stream0->CR & DMA_SxCR_CT) >> DMA_SxCR_CT_Pos) == 1U) ? 0U : 1U;
-    for (uint16_t i=0U; i < MIC_RX_BUF_SIZE; i++) {
-      mic_tx_buf[tx_buf_idx][2U*i] = ((mic_rx_buf[buf_idx][i] >> 16U) & 0xFFFFU);
-      mic_tx_buf[tx_buf_idx][(2U*i)+1U] = mic_tx_buf[tx_buf_idx][2U*i];
+    if ((sound_stats.mic_gain == MIC_GAIN_UNITY) && (sound_stats.mic_agc == 0U) && (sound_stats.mic_mono == 0U) && (mic_shift_up == 0U)) {
+      mic_convert(mic_rx_buf[buf_idx], mic_tx_buf[tx_buf_idx], MIC_RX_BUF_SIZE);
+      sound_stats.mic_peak = 0U;
+    } else {
+      sound_stats.mic_peak = mic_convert_gain(mic_rx_buf[buf_idx], mic_tx_buf[tx_buf_idx], MIC_RX_BUF_SIZE, sound_stats.mic_gain, mic_shift_up, sound_stats.mic_mono != 0U);
+    }
+
+    // AGC: back off quickly when the peak is over the target, recover slowly when well under it
+    if (sound_stats.mic_agc != 0U) {
+      if (sound_stats.mic_peak > MIC_AGC_TARGET) {
+        sound_stats.mic_gain = (uint16_t)MAX((uint32_t)sound_stats.mic_gain - (sound_stats.mic_gain / 8U), MIC_GAIN_UNITY);
+      } else if (sound_stats.mic_peak < (MIC_AGC_TARGET / 2U)) {
+        sound_stats.mic_gain = (uint16_t)MIN((uint32_t)sound_stats.mic_gain + (sound_stats.mic_gain / 64U) + 1U, MIC_GAIN_MAX);
+      } else {
+        // in range
+      }
     }
   }
+
+  sound_stats.mic_cycles = DWT->CYCCNT - start;
+  sound_stats.mic_cycles_max = MAX(sound_stats.mic_cycles_max, sound_stats.mic_cycles);
 }
 
-// Playback processing
+// Playback, SAI4_B -> sound_rx_buf: hands each completed buffer to the DAC side.
+// The DAC runs half a buffer out of phase with the SAI, so a handed off buffer
+// stays valid for half a buffer period (~5ms) after the DAC side picks it up.
+// Time spent in both playback ISRs is in get_probe_stats(), sound_rx and sound_tx.
 static void BDMA_Channel0_IRQ_Handler(void) {
-  static uint8_t playback_buf = 0U;
+  PROBE_BEGIN(PROBE_SOUND_RX);
+  uint32_t flags = BDMA->ISR;
+  BDMA->IFCR = BDMA_IFCR_CGIF0; // clear flags
 
-  BDMA->IFCR |= BDMA_IFCR_CGIF0; // clear flag
+  if ((flags & BDMA_ISR_TCIF0) != 0U) {
+    // CT already points at the buffer being filled next
+    sound_rx_ready_buf = (((BDMA_Channel0->CCR & BDMA_CCR_CT) >> BDMA_CCR_CT_Pos) == 1U) ? 0U : 1U;
+    sound_rx_ready = true;
 
-  uint8_t rx_buf_idx = (((BDMA_Channel0->CCR & BDMA_CCR_CT) >> BDMA_CCR_CT_Pos) == 1U) ? 0U : 1U;
-  playback_buf = 1U - playback_buf;
-
-  // wait until we're done playing the current buf
-  for (uint32_t timeout_counter = 100000U; timeout_counter > 0U; timeout_counter--){
-    uint8_t playing_buf = (DMA1_Stream1->CR & DMA_SxCR_CT) >> DMA_SxCR_CT_Pos;
-    if ((playing_buf != playback_buf) || ((DMA1_Stream1->CR & DMA_SxCR_EN) == 0U)) {
-      break;
+    // manage mic state
+    if (mic_idle_count == 0U) {
+      register_set_bits(&DFSDM1_Channel0->CHCFGR1, DFSDM_CHCFGR1_DFSDMEN);
+      DFSDM1_Filter0->FLTCR1 |= DFSDM_FLTCR1_RSWSTART;
     }
+    mic_idle_count = SOUND_IDLE_TIMEOUT;
   }
 
-  // process samples (shift to 12b and bias to be unsigned)
-  bool sound_playing = false;
-  uint32_t abs_sum = 0U;
+  // (re)start the DAC at half transfer to set the phase, it keeps it since both run off SAI4_FS_B
+  if (((flags & BDMA_ISR_HTIF0) != 0U) && ((DMA1_Stream1->CR & DMA_SxCR_EN) == 0U)) {
+    sound_fill(sound_tx_buf[0], (1U << 11), SOUND_TX_BUF_SIZE);
+    sound_fill(sound_tx_buf[1], (1U << 11), SOUND_TX_BUF_SIZE);
+    DMA1->LIFCR = (0x3FU << 6);
+    DMA1_Stream1->NDTR = SOUND_TX_BUF_SIZE;
+    register_clear_bits(&DMA1_Stream1->CR, DMA_SxCR_CT);
+    register_set_bits(&DMA1_Stream1->CR, DMA_SxCR_EN);
+  }
+  PROBE_END(PROBE_SOUND_RX);
+}
 
-  for (uint16_t i=0U; i < SOUND_RX_BUF_SIZE; i += 2U) {
-    // since we are playing mono and receiving stereo, we take every other sample
-    uint16_t sample = ((sound_rx_buf[rx_buf_idx][i] + (1UL << 14)) >> 3) & 0xFFFU;
-    sound_tx_buf[playback_buf][i/2U] = sample;
-    if (sound_rx_buf[rx_buf_idx][i] > 0U) {
-      sound_playing = true;
-    }
+// Playback, sound_rx_buf -> sound_tx_buf: refills the buffer the DAC just finished.
+// Runs at SOUND_DAC_IRQ_PRIORITY, so CAN and the host links can preempt the conversion.
+static void DMA1_Stream1_IRQ_Handler(void) {
+  PROBE_BEGIN(PROBE_SOUND_TX);
+  uint32_t start = DWT->CYCCNT;
+  DMA1->LIFCR = DMA_LIFCR_CTCIF1; // clear flag
 
-    // this assumes all audio is "zero" centered
-    if (sample > 0x7FFU) {
-      abs_sum += (uint32_t)sample - 0x7FFU;
-    } else {
-      abs_sum += 0x7FFU - (uint32_t)sample;
-    }
-  }
+  uint8_t tx_buf_idx = (((DMA1_Stream1->CR & DMA_SxCR_CT) >> DMA_SxCR_CT_Pos) == 1U) ? 0U : 1U;
 
-  // VU meter: fast attack, slow decay (~460ms half-life at ~96Hz ISR rate)
-  uint16_t level = (uint16_t)(abs_sum / (SOUND_RX_BUF_SIZE / 2U));
-  if (level >= sound_output_level) {
-    sound_output_level = level;
-  }
-  sound_output_level -= (sound_output_level >> 6U);
+  ENTER_CRITICAL();
+  bool rx_ready = sound_rx_ready;
+  uint8_t rx_buf_idx = sound_rx_ready_buf;
+  sound_rx_ready = false;
+  EXIT_CRITICAL();
 
-  // manage amp state
-  if (sound_playing) {
-    if (sound_idle_count == 0U) {
-      current_board->set_amp_enabled(true);
+  if (!rx_ready) {
+    // SAI stopped, play silence until sound_tick() stops the DAC
+    sound_fill(sound_tx_buf[tx_buf_idx], (1U << 11), SOUND_TX_BUF_SIZE);
+  } else {
+    // process samples (shift to 12b and bias to be unsigned)
+    bool sound_playing = false;
+    uint32_t abs_sum = sound_convert(sound_rx_buf[rx_buf_idx], sound_tx_buf[tx_buf_idx], SOUND_RX_BUF_SIZE / 2U, &sound_playing);
+
+    // VU meter: fast attack, slow decay (~460ms half-life at ~96Hz ISR rate)
+    uint16_t level = (uint16_t)(abs_sum / (SOUND_RX_BUF_SIZE / 2U));
+    if (level >= sound_output_level) {
+      sound_output_level = level;
+    }
+    sound_output_level -= (sound_output_level >> 6U);
 
-      // empty the other buf and start playing that
-      for (uint16_t i=0U; i < SOUND_TX_BUF_SIZE; i++) {
-        sound_tx_buf[1U - playback_buf][i] = (1UL << 11);
+    // manage amp state
+    if (sound_playing) {
+      if (sound_idle_count == 0U) {
+        current_board->set_amp_enabled(true);
       }
-      register_clear_bits(&DMA1_Stream1->CR, DMA_SxCR_EN);
-      DMA1_Stream1->CR = (DMA1_Stream1->CR & ~DMA_SxCR_CT_Msk) | ((1UL - playback_buf) << DMA_SxCR_CT_Pos);
-      register_set_bits(&DMA1_Stream1->CR, DMA_SxCR_EN);
+      sound_idle_count = SOUND_IDLE_TIMEOUT;
     }
-    sound_idle_count = SOUND_IDLE_TIMEOUT;
   }
 
-  // manage mic state
-  if (mic_idle_count == 0U) {
-    register_set_bits(&DFSDM1_Channel0->CHCFGR1, DFSDM_CHCFGR1_DFSDMEN);
-    DFSDM1_Filter0->FLTCR1 |= DFSDM_FLTCR1_RSWSTART;
-  }
-  mic_idle_count = SOUND_IDLE_TIMEOUT;
+  sound_stats.playback_cycles = DWT->CYCCNT - start;
+  sound_stats.playback_cycles_max = MAX(sound_stats.playback_cycles_max, sound_stats.playback_cycles);
+  PROBE_END(PROBE_SOUND_TX);
 }
 
 void sound_init_dac(void) {
@@ -140,7 +204,7 @@ void sound_init_dac(void) {
   register_set(&DMA1_Stream1->M1AR, (uint32_t) sound_tx_buf[1], 0xFFFFFFFFU);
   register_set(&DMA1_Stream1->FCR, 0U, 0x00000083U);
   DMA1_Stream1->NDTR = SOUND_TX_BUF_SIZE;
-  DMA1_Stream1->CR = DMA_SxCR_DBM | (0b11UL << DMA_SxCR_PL_Pos) | (0b01UL << DMA_SxCR_MSIZE_Pos) | (0b01UL << DMA_SxCR_PSIZE_Pos) | DMA_SxCR_MINC | (1U << DMA_SxCR_DIR_Pos);
+  DMA1_Stream1->CR = DMA_SxCR_DBM | (0b11UL << DMA_SxCR_PL_Pos) | (0b01UL << DMA_SxCR_MSIZE_Pos) | (0b01UL << DMA_SxCR_PSIZE_Pos) | DMA_SxCR_MINC | (1U << DMA_SxCR_DIR_Pos) | DMA_SxCR_TCIE;
 }
 
 static void sound_stop_dac(void) {
@@ -155,9 +219,115 @@ static void sound_stop_dac(void) {
   while ((DAC1->CR & (DAC_CR_EN1 | DAC_CR_EN2)) != 0U) {}
 }
 
+static uint32_t mic_filter_gain(uint8_t order, uint8_t oversampling) {
+  uint32_t gain = 1U;
+  for (uint8_t i = 0U; i < order; i++) {
+    gain *= oversampling;
+  }
+  return gain;
+}
+
+// The DFSDM data shift only goes right, it brings filters above MIC_FULL_SCALE down to it
+static uint32_t mic_filter_shift(uint8_t order, uint8_t oversampling) {
+  uint32_t gain = mic_filter_gain(order, oversampling);
+  uint32_t shift = 0U;
+  while ((gain >> shift) > MIC_FULL_SCALE) {
+    shift++;
+  }
+  return shift;
+}
+
+// Filters below MIC_FULL_SCALE are shifted up in the mic ISR instead, by mic_convert_gain()
+static uint8_t mic_filter_shift_up(uint8_t order, uint8_t oversampling) {
+  uint32_t gain = mic_filter_gain(order, oversampling);
+  uint8_t shift = 0U;
+  while ((shift < 16U) && ((gain << (shift + 1U)) <= MIC_FULL_SCALE)) {
+    shift++;
+  }
+  return shift;
+}
+
+// sinc1-5, and an oversampling ratio that divides MIC_CLK_DIV_X_OVERSAMPLING with a 1-3.3MHz PDM clock
+bool mic_set_filter(uint8_t order, uint8_t oversampling) {
+  bool ret = false;
+  if (sound_initialized && (order >= 1U) && (order <= 5U) && ((oversampling == 35U) || (oversampling == 55U) || (oversampling == 65U))) {
+    uint32_t clk_div = MIC_CLK_DIV_X_OVERSAMPLING / oversampling;
+
+    ENTER_CRITICAL();
+    // the clock divider, filter and data shift are only writable with everything off
+    bool running = (DFSDM1_Channel0->CHCFGR1 & DFSDM_CHCFGR1_DFSDMEN) != 0U;
+    register_clear_bits(&DFSDM1_Channel0->CHCFGR1, DFSDM_CHCFGR1_DFSDMEN);
+    register_clear_bits(&DFSDM1_Filter0->FLTCR1, DFSDM_FLTCR1_DFEN);
+    register_clear_bits(&DFSDM1_Channel3->CHCFGR1, DFSDM_CHCFGR1_CHEN);
+
+    register_set(&DFSDM1_Channel0->CHCFGR1, ((clk_div - 1U) << DFSDM_CHCFGR1_CKOUTDIV_Pos), DFSDM_CHCFGR1_CKOUTDIV_Msk);
+    register_set(&DFSDM1_Channel3->CHCFGR2, (mic_filter_shift(order, oversampling) << DFSDM_CHCFGR2_DTRBS_Pos), DFSDM_CHCFGR2_DTRBS_Msk);
+    mic_shift_up = mic_filter_shift_up(order, oversampling);
+    register_set(&DFSDM1_Filter0->FLTFCR, ((uint32_t)order << DFSDM_FLTFCR_FORD_Pos) | ((oversampling - 1UL) << DFSDM_FLTFCR_FOSR_Pos), DFSDM_FLTFCR_FORD_Msk | DFSDM_FLTFCR_FOSR_Msk);
+
+    register_set_bits(&DFSDM1_Channel3->CHCFGR1, DFSDM_CHCFGR1_CHEN);
+    register_set_bits(&DFSDM1_Filter0->FLTCR1, DFSDM_FLTCR1_DFEN);
+    if (running) {
+      register_set_bits(&DFSDM1_Channel0->CHCFGR1, DFSDM_CHCFGR1_DFSDMEN);
+      DFSDM1_Filter0->FLTCR1 |= DFSDM_FLTCR1_RSWSTART;
+    }
+
+    // let the new filter settle
+    mic_buffer_count = 0U;
+    sound_stats.mic_order = order;
+    sound_stats.mic_oversampling = oversampling;
+    EXIT_CRITICAL();
+    ret = true;
+  }
+  return ret;
+}
+
+// gain in 1/256 steps up to 16x, 0 for AGC. mono only sends SAI slot 0, halving the SAI4_A DMA traffic
+bool mic_set_output(uint16_t gain, bool mono) {
+  bool ret = false;
+  if (sound_initialized && (gain <= MIC_GAIN_MAX)) {
+    ENTER_CRITICAL();
+    sound_stats.mic_agc = (gain == 0U) ? 1U : 0U;
+    sound_stats.mic_gain = (gain == 0U) ? MIC_GAIN_UNITY : gain;
+
+    if (mono != (sound_stats.mic_mono != 0U)) {
+      register_clear_bits(&SAI4_Block_A->CR1, SAI_xCR1_SAIEN);
+      while ((SAI4_Block_A->CR1 & SAI_xCR1_SAIEN) != 0U) {}
+      register_clear_bits(&BDMA_Channel1->CCR, BDMA_CCR_EN);
+      while ((BDMA_Channel1->CCR & BDMA_CCR_EN) != 0U) {}
+
+      register_set(&SAI4_Block_A->SLOTR, ((mono ? 0b01UL : 0b11UL) << SAI_xSLOTR_SLOTEN_Pos), SAI_xSLOTR_SLOTEN_Msk);
+      register_set_bits(&SAI4_Block_A->CR2, SAI_xCR2_FFLUSH);
+      BDMA->IFCR = BDMA_IFCR_CGIF1;
+      BDMA_Channel1->CNDTR = mono ? MIC_RX_BUF_SIZE : MIC_TX_BUF_SIZE;
+
+      register_set_bits(&BDMA_Channel1->CCR, BDMA_CCR_EN);
+      register_set_bits(&SAI4_Block_A->CR1, SAI_xCR1_SAIEN);
+      sound_stats.mic_mono = mono ? 1U : 0U;
+      mic_buffer_count = 0U;
+    }
+    EXIT_CRITICAL();
+    ret = true;
+  }
+  return ret;
+}
+
+// reading resets the max cycle counts
+bool sound_get_stats(sound_stats_t *stats) {
+  if (sound_initialized) {
+    ENTER_CRITICAL();
+    *stats = sound_stats;
+    sound_stats.mic_cycles_max = 0U;
+    sound_stats.playback_cycles_max = 0U;
+    EXIT_CRITICAL();
+  }
+  return sound_initialized;
+}
+
 void sound_init(void) {
-  REGISTER_INTERRUPT(BDMA_Channel0_IRQn, BDMA_Channel0_IRQ_Handler, 128U, FAULT_INTERRUPT_RATE_SOUND_DMA)
+  REGISTER_INTERRUPT(BDMA_Channel0_IRQn, BDMA_Channel0_IRQ_Handler, 256U, FAULT_INTERRUPT_RATE_SOUND_DMA)
   REGISTER_INTERRUPT(DMA1_Stream0_IRQn, DMA1_Stream0_IRQ_Handler, 128U, FAULT_INTERRUPT_RATE_SOUND_DMA)
+  REGISTER_INTERRUPT(DMA1_Stream1_IRQn, DMA1_Stream1_IRQ_Handler, 128U, FAULT_INTERRUPT_RATE_SOUND_DMA)
 
   // Init DAC and its DMA
   sound_init_dac();
@@ -185,7 +355,7 @@ void sound_init(void) {
   register_set(&BDMA_Channel0->CM0AR, (uint32_t) sound_rx_buf[0], 0xFFFFFFFFU);
   register_set(&BDMA_Channel0->CM1AR, (uint32_t) sound_rx_buf[1], 0xFFFFFFFFU);
   BDMA_Channel0->CNDTR = SOUND_RX_BUF_SIZE;
-  register_set(&BDMA_Channel0->CCR, BDMA_CCR_DBM | (0b01UL << BDMA_CCR_MSIZE_Pos) | (0b01UL << BDMA_CCR_PSIZE_Pos) | BDMA_CCR_MINC | BDMA_CCR_CIRC | BDMA_CCR_TCIE, 0xFFFFU);
+  register_set(&BDMA_Channel0->CCR, BDMA_CCR_DBM | (0b01UL << BDMA_CCR_MSIZE_Pos) | (0b01UL << BDMA_CCR_PSIZE_Pos) | BDMA_CCR_MINC | BDMA_CCR_CIRC | BDMA_CCR_TCIE | BDMA_CCR_HTIE, 0xFFFFU);
   register_set(&DMAMUX2_Channel0->CCR, 16U, DMAMUX_CxCR_DMAREQ_ID_Msk); // SAI4_B_DMA
   register_set_bits(&BDMA_Channel0->CCR, BDMA_CCR_EN);
 
@@ -225,4 +395,7 @@ void sound_init(void) {
   register_set_bits(&SAI4_Block_B->CR1, SAI_xCR1_SAIEN);
   NVIC_EnableIRQ(BDMA_Channel0_IRQn);
   NVIC_EnableIRQ(DMA1_Stream0_IRQn);
+  NVIC_SetPriority(DMA1_Stream1_IRQn, SOUND_DAC_IRQ_PRIORITY);
+  NVIC_EnableIRQ(DMA1_Stream1_IRQn);
+  sound_initialized = true;
 }
@@ -0,0 +1,102 @@
+#pragma once
+
+// Sample conversion kernels for sound.h. The *_ref versions are the plain per-sample loops,
+// the others work on two 16-bit samples per instruction with the M7 DSP extension.
+// Both are bit exact, tests/libpanda/sound_dsp.c checks them against each other on the host.
+// The DSP versions access the uint16_t buffers a word at a time, so those must be 4-byte
+// aligned. The buffers in sound.h are declared aligned(4) for this.
+
+#define SOUND_DAC_MID 0x7FFU
+
+// SAI stereo -> 12b mono DAC samples, shifted to 12b and biased to be unsigned.
+// Returns the sum of |sample - SOUND_DAC_MID| for the VU meter, *playing is set if any input sample is non-zero.
+uint32_t sound_convert_ref(const uint16_t *rx, uint16_t *tx, uint32_t frames, bool *playing) {
+  uint32_t abs_sum = 0U;
+  for (uint32_t i = 0U; i < frames; i++) {
+    // since we are playing mono and receiving stereo, we take every other sample
+    uint16_t sample = ((rx[2U*i] + (1UL << 14)) >> 3) & 0xFFFU;
+    tx[i] = sample;
+    if (rx[2U*i] > 0U) {
+      *playing = true;
+    }
+
+    // this assumes all audio is "zero" centered
+    if (sample > SOUND_DAC_MID) {
+      abs_sum += (uint32_t)sample - SOUND_DAC_MID;
+    } else {
+      abs_sum += SOUND_DAC_MID - (uint32_t)sample;
+    }
+  }
+  return abs_sum;
+}
+
+// frames must be even, rx and tx word aligned
+uint32_t sound_convert(const uint16_t *rx, uint16_t *tx, uint32_t frames, bool *playing) {
+  const uint32_t *rx32 = (const uint32_t *)rx; // cppcheck-suppress misra-c2012-11.3 ; buffers are word aligned
+  uint32_t *tx32 = (uint32_t *)tx; // cppcheck-suppress misra-c2012-11.3 ; buffers are word aligned
+  uint32_t abs_sum = 0U;
+  uint32_t any = 0U;
+
+  for (uint32_t i = 0U; i < (frames / 2U); i++) {
+    // left channels of two frames into one word
+    uint32_t left = __PKHBT(rx32[2U*i], rx32[(2U*i) + 1U], 16);
+    any |= left;
+
+    // per half: +(1 << 14), then >> 3. the bits shifted across the halves are masked off
+    uint32_t sample = (__UADD16(left, 0x40004000U) >> 3) & 0x0FFF0FFFU;
+    tx32[i] = sample;
+
+    // |sample - mid| per half, sel picks by the GE flags of the last usub16
+    uint32_t below = __USUB16(0x07FF07FFU, sample);
+    uint32_t above = __USUB16(sample, 0x07FF07FFU);
+    abs_sum = __SMLAD(__SEL(above, below), 0x00010001U, abs_sum);
+  }
+
+  if (any != 0U) {
+    *playing = true;
+  }
+  return abs_sum;
+}
+
+// DFSDM 24b samples in the top of each word -> top 16b, duplicated into both SAI stereo slots
+void mic_convert_ref(const uint32_t *rx, uint16_t *tx, uint32_t n) {
+  for (uint32_t i = 0U; i < n; i++) {
+    tx[2U*i] = ((rx[i] >> 16U) & 0xFFFFU);
+    tx[(2U*i) + 1U] = tx[2U*i];
+  }
+}
+
+// tx word aligned
+void mic_convert(const uint32_t *rx, uint16_t *tx, uint32_t n) {
+  uint32_t *tx32 = (uint32_t *)tx; // cppcheck-suppress misra-c2012-11.3 ; buffers are word aligned
+  for (uint32_t i = 0U; i < n; i++) {
+    tx32[i] = __PKHTB(rx[i], rx[i], 16);
+  }
+}
+
+// mic_convert() with a digital gain in 1/256 steps, saturating. up (0-16) first shifts the 24b
+// sample left, for filters whose gain is below full scale. mono writes one sample per SAI frame
+// instead of duplicating it into both slots. Returns the peak |sample| after the gain. tx word aligned
+uint16_t mic_convert_gain(const uint32_t *rx, uint16_t *tx, uint32_t n, uint16_t gain, uint8_t up, bool mono) {
+  uint32_t *tx32 = (uint32_t *)tx; // cppcheck-suppress misra-c2012-11.3 ; buffers are word aligned
+  uint32_t peak = 0U;
+  for (uint32_t i = 0U; i < n; i++) {
+    int32_t sample = __SSAT((int32_t)rx[i] >> (16U - up), 16);
+    sample = __SSAT((sample * (int32_t)gain) >> 8, 16);
+    peak = MAX(peak, (uint32_t)((sample < 0) ? -sample : sample));
+    if (mono) {
+      tx[i] = (uint16_t)sample;
+    } else {
+      tx32[i] = ((uint32_t)sample & 0xFFFFU) * 0x00010001U;
+    }
+  }
+  return (uint16_t)peak;
+}
+
+// n must be even, tx word aligned
+void sound_fill(uint16_t *tx, uint16_t value, uint32_t n) {
+  uint32_t *tx32 = (uint32_t *)tx; // cppcheck-suppress misra-c2012-11.3 ; buffers are word aligned
+  for (uint32_t i = 0U; i < (n / 2U); i++) {
+    tx32[i] = ((uint32_t)value << 16) | value;
+  }
+}
@@ -35,9 +35,16 @@ separate IRQs for RX and TX.
 
 #define MICROSECOND_TIMER TIM2
 
+// compare channel 1 of the microsecond timer steps CAN cores while they (re)initialize
+#define CAN_INIT_TIMER_IRQ TIM2_IRQn
+#define CAN_INIT_TIMER MICROSECOND_TIMER
+
 #define INTERRUPT_TIMER_IRQ TIM6_DAC_IRQn
 #define INTERRUPT_TIMER TIM6
 
+#define LED_FADE_TIMER_IRQ TIM4_IRQn
+#define LED_FADE_TIMER TIM4
+
 #define IND_WDG IWDG1
 
 #define PROVISION_CHUNK_ADDRESS 0x080FFFE0U
@@ -56,6 +63,8 @@ separate IRQs for RX and TX.
 #include "board/sys/critical.h"
 #include "board/sys/faults.h"
 #include "board/utils.h"
+#include "board/probe.h"
+#include "board/trace.h"
 
 #include "board/drivers/registers.h"
 #include "board/drivers/interrupts.h"
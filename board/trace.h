@@ -0,0 +1,117 @@
+#pragma once
+
+// Binary event trace: hot paths log an event id, the cycle counter and two args into a ring
+// in SRAM1/2, the host drains it as a byte stream over USB EP4 or SPI endpoint 4 and turns it
+// into a timeline with scripts/trace.py. Started and stopped over 0xac, stats over 0xad.
+// When the ring is full new events are dropped, and a TRACE_DROPPED marker is logged once there is room again.
+// Only built into debug builds of the panda app, everywhere else TRACE() compiles to nothing.
+#define TRACE_CAN_RX 0U           // span, arg0: bus, arg1: RX FIFO 0 fill level on entry, can_rx_q free slots on exit
+#define TRACE_PROCESS_CAN 1U      // span, arg0: bus, arg1: TX queue free slots
+#define TRACE_SPI_RX_DONE 2U      // span, arg0: endpoint, arg1: MOSI length on entry, response length on exit
+#define TRACE_USB_IRQ 3U          // span, arg1: GINTSTS on entry
+#define TRACE_COMMS_CAN_READ 4U   // instant, arg0: bytes out, arg1: can_rx_q free slots
+#define TRACE_COMMS_CAN_WRITE 5U  // instant, arg0: bytes in, arg1: free slots in the fullest TX queue
+#define TRACE_DROPPED 6U          // instant, arg1: events dropped
+#define TRACE_END 0x8000U         // or'd into the id at the end of a span
+
+typedef struct __attribute__((packed)) {
+  uint32_t ts;  // DWT->CYCCNT
+  uint16_t id;
+  uint16_t arg0;
+  uint32_t arg1;
+} trace_event_t;
+
+typedef struct __attribute__((packed)) {
+  uint32_t cnt;      // events logged since the last start
+  uint32_t dropped;  // events dropped on a full ring since the last start
+  uint32_t pending;  // bytes not drained yet
+  uint32_t core_freq_mhz;  // event timestamps are core cycles
+} trace_stats_t;
+
+#if defined(ALLOW_DEBUG) && defined(STM32H7) && !defined(BOOTSTUB) && !defined(PANDA_JUNGLE) && !defined(PANDA_BODY)
+#define TRACE_ENABLED
+
+#define TRACE_RING_SIZE (1024U * sizeof(trace_event_t))  // 12K, SRAM1/2 only holds the SPI buffers otherwise
+
+// written in whole events, drained in bytes so the host gets full packets
+__attribute__((section(".sram12"))) static uint8_t trace_ring[TRACE_RING_SIZE];
+static uint32_t trace_w_ptr = 0U;
+static uint32_t trace_r_ptr = 0U;
+static uint32_t trace_len = 0U;
+static uint32_t trace_pending_drops = 0U;
+static bool trace_enabled = false;
+static trace_stats_t trace_stats;
+
+#define TRACE(id, arg0, arg1) trace_log((id), (arg0), (arg1))
+
+void trace_push(uint32_t ts, uint16_t id, uint16_t arg0, uint32_t arg1) {
+  trace_event_t *ev = (trace_event_t *)&trace_ring[trace_w_ptr];
+  ev->ts = ts;
+  ev->id = id;
+  ev->arg0 = arg0;
+  ev->arg1 = arg1;
+  trace_w_ptr = ((trace_w_ptr + sizeof(trace_event_t)) == TRACE_RING_SIZE) ? 0U : (trace_w_ptr + sizeof(trace_event_t));
+  trace_len += sizeof(trace_event_t);
+}
+
+void trace_log(uint16_t id, uint16_t arg0, uint32_t arg1) {
+  ENTER_CRITICAL();
+  if (trace_enabled) {
+    uint32_t ts = DWT->CYCCNT;
+    uint32_t space = TRACE_RING_SIZE - trace_len;
+    if ((trace_pending_drops > 0U) && (space >= (2U * sizeof(trace_event_t)))) {
+      trace_push(ts, TRACE_DROPPED, 0U, trace_pending_drops);
+      trace_pending_drops = 0U;
+      space -= sizeof(trace_event_t);
+    }
+    if ((trace_pending_drops == 0U) && (space >= sizeof(trace_event_t))) {
+      trace_push(ts, id, arg0, arg1);
+      trace_stats.cnt += 1U;
+    } else {
+      trace_pending_drops += 1U;
+      trace_stats.dropped += 1U;
+    }
+  }
+  EXIT_CRITICAL();
+}
+
+void trace_set_enabled(bool enabled) {
+  ENTER_CRITICAL();
+  if (enabled && !trace_enabled) {
+    trace_w_ptr = 0U;
+    trace_r_ptr = 0U;
+    trace_len = 0U;
+    trace_pending_drops = 0U;
+    (void)memset(&trace_stats, 0, sizeof(trace_stats));
+  }
+  trace_enabled = enabled;
+  EXIT_CRITICAL();
+}
+
+void trace_get_stats(trace_stats_t *stats) {
+  ENTER_CRITICAL();
+  *stats = trace_stats;
+  stats->pending = trace_len;
+  stats->core_freq_mhz = CORE_FREQ;
+  EXIT_CRITICAL();
+}
+
+// single reader: writers never touch unread bytes, so only the pointer updates need the lock
+uint16_t trace_read(uint8_t *buf, uint16_t max_len) {
+  ENTER_CRITICAL();
+  uint32_t len = MIN(trace_len, max_len);
+  EXIT_CRITICAL();
+
+  uint32_t first = MIN(len, TRACE_RING_SIZE - trace_r_ptr);
+  (void)memcpy(buf, &trace_ring[trace_r_ptr], first);
+  (void)memcpy(&buf[first], trace_ring, len - first);
+
+  ENTER_CRITICAL();
+  trace_r_ptr = ((trace_r_ptr + len) >= TRACE_RING_SIZE) ? (trace_r_ptr + len - TRACE_RING_SIZE) : (trace_r_ptr + len);
+  trace_len -= len;
+  EXIT_CRITICAL();
+  return (uint16_t)len;
+}
+#else
+#define TRACE(id, arg0, arg1)
+#endif
@@ -14,7 +14,7 @@ from itertools import accumulate
 import opendbc
 from opendbc.car.structs import CarParams
 
-from .base import BaseHandle
+from .base import BaseHandle, TIMEOUT
 from .constants import BASEDIR, FW_PATH, McuType, compute_version_hash
 from .dfu import PandaDFU
 from .spi import PandaSpiHandle, PandaSpiException, PandaProtocolMismatch
@@ -73,6 +73,32 @@ def pack_can_buffer(arr, chunk=False, fd=False):
 
   return snds
 
+def flash_blocks(code, sector_size):
+  """
+  Per-sector SHA1 of an app image, as (sector, length, digest). Lengths are whole words,
+  matching what the flasher programs. SConscript writes the same index next to each .bin.signed.
+  """
+  ret = []
+  for i in range(0, len(code), sector_size):
+    dat = code[i:i + sector_size]
+    dat = dat[:len(dat) - (len(dat) % 4)]
+    ret.append((1 + i // sector_size, len(dat), hashlib.sha1(dat).digest()))
+  return ret
+
+def load_flash_blocks(fn, code):
+  """
+  The build's block index for fn, see flash_blocks(). None if there isn't one or it
+  doesn't cover code, e.g. the image was rebuilt without it.
+  """
+  try:
+    with open(fn + ".blocks") as f:
+      blocks = [(int(s), int(n), bytes.fromhex(digest)) for s, n, digest in (line.split() for line in f.read().splitlines())]
+  except (OSError, ValueError):
+    return None
+  if sum(n for _, n, _ in blocks) != len(code) - (len(code) % 4):
+    return None
+  return blocks
+
 def unpack_can_buffer(dat):
   ret = []
 
@@ -150,6 +176,9 @@ class Panda:
   HARNESS_STATUS_NORMAL = 1
   HARNESS_STATUS_FLIPPED = 2
 
+  # flasher capability flags, in the 0xb0 status
+  FLASHER_CAP_DELTA = 1
+
   def __init__(self, serial: str | None = None, claim: bool = True, disable_checks: bool = True, can_speed_kbps: int = 500, cli: bool = True):
     self._disable_checks = disable_checks
 
@@ -220,6 +249,7 @@ class Panda:
     self._connect_serial = serial
     self._handle_open = True
     self.health_version, self.can_version = self.get_packets_versions()
+    self._serial_bulk = None  # serial bulk endpoint support, probed on the first SOM debug read
     logger.debug("connected")
 
     # disable openpilot's heartbeat checks
@@ -395,7 +425,32 @@ class Panda:
     return fr[4:8] == b"\xde\xad\xd0\x0d"
 
   @staticmethod
-  def flash_static(handle, code, mcu_type):
+  def flasher_status(handle: BaseHandle, sector: int = 0) -> dict:
+    fr = handle.controlRead(Panda.REQUEST_IN, 0xb0, sector, 0, 0x20)
+    status = {
+      "prog_ptr": struct.unpack("<I", fr[8:12])[0],
+      "caps": 0,
+    }
+    # older flashers return a shorter blob
+    if len(fr) >= 0x14:
+      status.update({
+        "erase_next": fr[12],
+        "erase_last": fr[13],
+        "busy": bool(fr[14]),
+        "error": bool(fr[15]),
+        "staged": struct.unpack("<I", fr[16:20])[0],
+      })
+    if len(fr) >= 0x20:
+      status["erase_us"], status["program_us"], status["caps"] = struct.unpack("<III", fr[20:32])
+    return status
+
+  @staticmethod
+  def flash_static(handle, code, mcu_type, delta=False, blocks=None):
+    """
+    Returns the bytes sent and sectors programmed. With delta=True, only the sectors
+    whose contents differ from what's on the device are erased and reprogrammed.
+    blocks is the build's index for code, it's hashed here without one.
+    """
     assert mcu_type is not None, "must set valid mcu_type to flash"
 
     # confirm flasher is present
@@ -411,16 +466,60 @@ class Panda:
     logger.info("flash: unlocking")
     handle.controlWrite(Panda.REQUEST_IN, 0xb1, 0, 0, b'')
 
-    # erase sectors
-    logger.info(f"flash: erasing sectors 1 - {last_sector}")
-    for i in range(1, last_sector + 1):
-      handle.controlWrite(Panda.REQUEST_IN, 0xb2, i, 0, b'')
-
-    # flash over EP2
-    STEP = 0x200
-    logger.info("flash: flashing")
-    for i in range(0, len(code), STEP):
-      handle.bulkWrite(2, code[i:i + STEP])
+    # flash over EP2. the flasher stages full 256-bit flash words,
+    # so large chunks stream straight into back-to-back flash word programming
+    STEP = 0x4000
+    sector_size = mcu_type.config.sector_sizes[1]
+    flash_start = time.monotonic()
+    stats = {"bytes": 0, "sectors": list(range(1, last_sector + 1))}
+
+    def write(dat, first_sector):
+      for i in range(0, len(dat), sector_size):
+        st = time.monotonic()
+        for j in range(i, min(i + sector_size, len(dat)), STEP):
+          handle.bulkWrite(2, dat[j:j + STEP])
+        logger.debug(f"flash: programmed sector {first_sector + i // sector_size} in {(time.monotonic() - st)*1e3:.1f}ms")
+      stats["bytes"] += len(dat)
+
+    # delta update: compare each sector's hash against the device
+    if delta and not (Panda.flasher_status(handle)["caps"] & Panda.FLASHER_CAP_DELTA):
+      logger.info("flash: flasher doesn't support delta updates, flashing everything")
+      delta = False
+    if delta:
+      if blocks is None:
+        blocks = flash_blocks(code, sector_size)
+      stats["sectors"] = [s for s, n, digest in blocks
+                          if bytes(handle.controlRead(Panda.REQUEST_IN, 0xb4, s, n // 4, 20)) != digest]
+      logger.info(f"flash: delta update, sectors {stats['sectors']} changed")
+      for s in stats["sectors"]:
+        handle.controlWrite(Panda.REQUEST_IN, 0xb2, s, 0, b'')
+        handle.controlWrite(Panda.REQUEST_IN, 0xb6, s, 0, b'')
+        write(code[(s - 1) * sector_size:s * sector_size], s)
+    else:
+      # erase sectors. newer flashers erase in the background, ahead of the data stream
+      logger.info(f"flash: erasing sectors 1 - {last_sector}")
+      erase_ahead = handle.controlRead(Panda.REQUEST_IN, 0xb3, last_sector, 0, 0xc)[1] == 0xff
+      if not erase_ahead:
+        for i in range(1, last_sector + 1):
+          st = time.monotonic()
+          handle.controlWrite(Panda.REQUEST_IN, 0xb2, i, 0, b'')
+          logger.debug(f"flash: erased sector {i} in {(time.monotonic() - st)*1e3:.1f}ms")
+
+      logger.info("flash: flashing")
+      write(code, 1)
+
+      # wait for the background erases and staged data, less than one flash word is left for the reset
+      while erase_ahead:
+        status = Panda.flasher_status(handle)
+        assert not status["error"], "flash: data past the erased sectors"
+        if status["erase_next"] > status["erase_last"] and not status["busy"] and status["staged"] < 32:
+          break
+        time.sleep(0.01)
+    logger.debug(f"flash: erase + program took {(time.monotonic() - flash_start)*1e3:.1f}ms")
+    for s in stats["sectors"]:
+      status = Panda.flasher_status(handle, s)
+      if "erase_us" in status:
+        logger.debug(f"flash: sector {s} erase {status['erase_us']/1e3:.1f}ms, program {status['program_us']/1e3:.1f}ms (on device)")
 
     # reset
     logger.info("flash: resetting")
@@ -428,13 +527,14 @@ class Panda:
       handle.controlWrite(Panda.REQUEST_IN, 0xd8, 0, 0, b'', expect_disconnect=True)
     except Exception:
       pass
+    return stats
 
-  def flash(self, fn=None, code=None, reconnect=True):
+  def flash(self, fn=None, code=None, reconnect=True, delta=False):
     assert (hw_type := self.get_type()) in self.SUPPORTED_DEVICES, f"Unknown HW: {hw_type}"
 
     if self.up_to_date(fn=fn):
       logger.info("flash: already up to date")
-      return
+      return None
 
     if not fn:
       fn = os.path.join(FW_PATH, McuType.H7.config.app_fn)
@@ -444,19 +544,22 @@ class Panda:
       self.reset(enter_bootstub=True)
     assert(self.bootstub)
 
+    blocks = None
     if code is None:
       with open(fn, "rb") as f:
         code = f.read()
+      blocks = load_flash_blocks(fn, code)
 
     # get version
     logger.debug("flash: bootstub version is %s", self.get_version())
 
     # do flash
-    Panda.flash_static(self._handle, code, mcu_type=McuType.H7)
+    stats = Panda.flash_static(self._handle, code, mcu_type=McuType.H7, delta=delta, blocks=blocks)
 
     # reconnect
     if reconnect:
       self.reconnect()
+    return stats
 
   def recover(self, timeout: int | None = 60, reset: bool = True) -> bool:
     dfu_serial = self.get_dfu_serial()
@@ -545,6 +648,7 @@ class Panda:
       "sound_output_level": a[25],
       "controls_allowed_lateral": a[26],
       "controls_allowed_longitudinal": a[27],
+      "sbu_measure_max_us": a[28],
     }
 
   @ensure_health_packet_version
@@ -590,6 +694,15 @@ class Panda:
       "can_core_reset_count": a[25],
     }
 
+  def can_init_stats(self, bus):
+    """
+      Returns how long (re)initializing the bus' FDCAN core took, e.g. after a bitrate change or core reset
+    """
+    dat = self._handle.controlRead(Panda.REQUEST_IN, 0xaa, int(bus), 0, 0x40)
+    busy, last_time_us, max_time_us, cnt, timeout_cnt, faulted = struct.unpack("<BIIIIB", dat)
+    return {"busy": bool(busy), "last_time_us": last_time_us, "max_time_us": max_time_us, "cnt": cnt, "timeout_cnt": timeout_cnt,
+            "faulted": bool(faulted)}
+
   # ******************* control *******************
 
   def get_version(self):
@@ -647,6 +760,87 @@ class Panda:
   def get_secret(self):
     return self._handle.controlRead(Panda.REQUEST_IN, 0xd0, 1, 0, 0x10)
 
+  # must match BOOT_STAGE_* in board/boot_profile.h
+  BOOT_STAGES = ["clock_init", "board_detect", "sha", "rsa",
+                 "app_early", "app_board", "app_can", "app_analog", "app_safety", "app_comms", "first_rx"]
+
+  def get_boot_profile(self):
+    """
+      Returns the time in us spent in each boot stage, from reset through the
+      bootstub and main() up to the first received CAN frame. app_len is 0 if
+      the app wasn't started by the bootstub, first_rx is 0 until a frame arrives.
+    """
+    dat = self._handle.controlRead(Panda.REQUEST_IN, 0xa9, 0, 0, 0x40)
+    if len(dat) < 8:
+      return None
+    magic, app_len = struct.unpack("<II", dat[:8])
+    stages = struct.unpack(f"<{len(Panda.BOOT_STAGES)}I", dat[8:8 + 4*len(Panda.BOOT_STAGES)])
+    return {"app_len": app_len, **dict(zip(Panda.BOOT_STAGES, stages, strict=True))}
+
+  PROBES = ["can_rx", "process_can", "comms_can_read", "comms_can_write", "spi_rx_done", "safety_rx", "safety_tx", "sound_rx", "sound_tx"]
+
+  def get_probe_stats(self, reset=False):
+    """
+      Returns the cycles spent per call in the firmware's hot paths: min/avg/max over
+      the last 16 calls, and the max and call count since boot or the last reset.
+      Empty on release builds, where the probes are compiled out.
+    """
+    ret = {}
+    for i, name in enumerate(Panda.PROBES):
+      dat = self._handle.controlRead(Panda.REQUEST_IN, 0xab, i, int(reset), 0x40)
+      if len(dat) < 20:
+        return {}
+      cnt, min_cycles, avg_cycles, max_cycles, max_all_cycles = struct.unpack("<IIIII", dat[:20])
+      ret[name] = {"cnt": cnt, "min": min_cycles, "avg": avg_cycles, "max": max_cycles, "max_all": max_all_cycles}
+    return ret
+
+  def trace_start(self):
+    """Clears and starts the firmware's binary event trace, debug builds only. Decode with scripts/trace.py."""
+    self._handle.controlWrite(Panda.REQUEST_OUT, 0xac, 1, 0, b'')
+
+  def trace_stop(self):
+    self._handle.controlWrite(Panda.REQUEST_OUT, 0xac, 0, 0, b'')
+
+  def trace_read(self):
+    """Drains the event trace, returns the raw 12 byte events. Events can be split across reads."""
+    return bytes(self._handle.bulkRead(4, 16384))
+
+  def get_trace_stats(self):
+    dat = self._handle.controlRead(Panda.REQUEST_IN, 0xad, 0, 0, 16)
+    if len(dat) < 12:
+      return None
+    cnt, dropped, pending = struct.unpack("<III", dat[:12])
+    core_freq_mhz = struct.unpack("<I", dat[12:16])[0] if len(dat) >= 16 else None
+    return {"cnt": cnt, "dropped": dropped, "pending": pending, "core_freq_mhz": core_freq_mhz}
+
+  def set_mic_filter(self, order=4, oversampling=55):
+    """sinc1-5 filter, oversampling 35, 55 or 65. The PDM clock is adjusted to keep ~48kHz out."""
+    self._handle.controlWrite(Panda.REQUEST_OUT, 0xae, int(order), int(oversampling), b'')
+
+  def set_mic_output(self, gain=1.0, mono=False):
+    """gain of None turns on the AGC, mono only sends the first SAI slot"""
+    gain = 0 if gain is None else max(1, min(int(round(gain * 256)), 4096))
+    self._handle.controlWrite(Panda.REQUEST_OUT, 0xaf, gain, int(mono), b'')
+
+  def get_sound_stats(self):
+    """Mic and playback settings, and the CPU cycles spent per ~10.7ms buffer. Reading resets the max."""
+    dat = self._handle.controlRead(Panda.REQUEST_IN, 0xa5, 0, 0, 24)
+    if len(dat) < 24:
+      return None
+    order, oversampling, gain, agc, mono, peak, mic, mic_max, playback, playback_max = struct.unpack("<BBHBBHIIII", dat)
+    return {"mic_order": order, "mic_oversampling": oversampling, "mic_gain": gain / 256, "mic_agc": bool(agc),
+            "mic_mono": bool(mono), "mic_peak": peak, "mic_cycles": mic, "mic_cycles_max": mic_max,
+            "playback_cycles": playback, "playback_cycles_max": playback_max}
+
+  def get_idle_stats(self):
+    """Fraction of the last second the main loop slept, wakeups, and the interrupt latency measured by the LED fade timer."""
+    dat = self._handle.controlRead(Panda.REQUEST_IN, 0xa6, 0, 0, 20)
+    if len(dat) < 20:
+      return None
+    idle, window, wakeups, latency_max, latency_max_all = struct.unpack("<IIIII", dat)
+    return {"idle_fraction": idle / window if window > 0 else 0.0, "wakeups": wakeups,
+            "wake_latency_max_ns": latency_max, "wake_latency_max_all_ns": latency_max_all}
+
   def get_interrupt_call_rate(self, irqnum):
     dat = self._handle.controlRead(Panda.REQUEST_IN, 0xc4, int(irqnum), 0, 4)
     return struct.unpack("I", dat)[0]
@@ -746,6 +940,22 @@ class Panda:
   # ******************* serial *******************
 
   def serial_read(self, port_number, maxlen=1024):
+    """Drains up to maxlen bytes of the port's RX ring. The SOM debug port is read over the serial
+    bulk endpoint, other ports and firmware without that endpoint use 0xe0, 64 bytes per transfer."""
+    if (port_number == Panda.SERIAL_SOM_DEBUG) and (self._serial_bulk is not False):
+      try:
+        # whole packets, the last one can't be cut short on USB.
+        # old firmware NACKs the endpoint on SPI until the timeout, so the probe is kept short
+        timeout = 100 if self._serial_bulk is None else TIMEOUT
+        ret = bytes(self._handle.bulkRead(5, (maxlen + 0x3F) & ~0x3F, timeout))
+        self._serial_bulk = True
+        return ret
+      except (usb1.USBErrorNotFound, usb1.USBErrorPipe, usb1.USBErrorIO, usb1.USBErrorTimeout, PandaSpiException):
+        if self._serial_bulk:
+          raise
+        logger.debug("no serial bulk endpoint, falling back to 0xe0")
+        self._serial_bulk = False
+
     ret = b''
     while 1:
       r = bytes(self._handle.controlRead(Panda.REQUEST_IN, 0xe0, port_number, 0, 0x40))
@@ -755,11 +965,14 @@ class Panda:
     return ret
 
   def serial_write(self, port_number, ln):
-    ret = 0
+    """Returns the bytes sent on the endpoint, port number bytes included."""
     if isinstance(ln, str):
       ln = bytes(ln, 'utf-8')
-    for i in range(0, len(ln), 0x20):
-      ret += self._handle.bulkWrite(2, struct.pack("B", port_number) + ln[i:i + 0x20])
+    # every 64 byte packet starts with the port number
+    dat = b''.join(struct.pack("B", port_number) + ln[i:i + 0x3F] for i in range(0, len(ln), 0x3F))
+    ret = 0
+    if len(dat):
+      ret = self._handle.bulkWrite(2, dat)
     return ret
 
   def send_heartbeat(self, engaged=True, engaged_mads=True):
@@ -0,0 +1,97 @@
+import asyncio
+from concurrent.futures import ThreadPoolExecutor
+
+from . import Panda
+
+
+class AsyncPanda:
+  """
+  asyncio wrapper around a Panda.
+
+  The USB and SPI handles are blocking, so the transfers run on executor
+  threads. Each traffic class gets its own single-thread executor, so
+  control transfers, CAN RX and CAN TX don't queue behind each other here.
+  Whether they overlap on the wire depends on the transport:
+    - USB: libusb runs transfers on different endpoints concurrently, so
+      health() can be awaited while a CAN stream is running.
+    - SPI: every transfer takes SPI_LOCK in spi.py. A control request waits
+      for the CAN transfer in flight, and the next CAN transfer waits for it.
+  """
+
+  # how long the CAN stream waits before polling again after an empty read
+  CAN_POLL_INTERVAL = 0.001
+
+  def __init__(self, panda: Panda):
+    self.panda = panda
+    self._ctrl = ThreadPoolExecutor(max_workers=1, thread_name_prefix="panda-ctrl")
+    self._can_rx = ThreadPoolExecutor(max_workers=1, thread_name_prefix="panda-can-rx")
+    self._can_tx = ThreadPoolExecutor(max_workers=1, thread_name_prefix="panda-can-tx")
+
+  @classmethod
+  async def open(cls, serial: str | None = None, **kwargs) -> "AsyncPanda":
+    kwargs.setdefault("cli", False)
+    panda = await asyncio.get_running_loop().run_in_executor(None, lambda: Panda(serial, **kwargs))
+    return cls(panda)
+
+  async def __aenter__(self):
+    return self
+
+  async def __aexit__(self, *args):
+    await self.close()
+
+  async def close(self):
+    # joining the executors waits on in-flight transfers, keep that off the event loop
+    def shutdown():
+      for ex in (self._can_rx, self._can_tx, self._ctrl):
+        ex.shutdown(wait=True, cancel_futures=True)
+      self.panda.close()
+    await asyncio.to_thread(shutdown)
+
+  def _run(self, executor, fn, *args, **kwargs):
+    return asyncio.get_running_loop().run_in_executor(executor, lambda: fn(*args, **kwargs))
+
+  # ******************* control *******************
+
+  async def control_read(self, request: int, value: int, index: int, length: int, timeout: int | None = None) -> bytes:
+    kwargs = {} if timeout is None else {"timeout": timeout}
+    return await self._run(self._ctrl, self.panda._handle.controlRead, Panda.REQUEST_IN, request, value, index, length, **kwargs)
+
+  async def control_write(self, request: int, value: int, index: int, data=b'', timeout: int | None = None):
+    kwargs = {} if timeout is None else {"timeout": timeout}
+    return await self._run(self._ctrl, self.panda._handle.controlWrite, Panda.REQUEST_OUT, request, value, index, data, **kwargs)
+
+  async def call(self, name: str, *args, **kwargs):
+    """Runs any other blocking Panda method on the control executor, e.g. await p.call("set_safety_mode", ...)"""
+    return await self._run(self._ctrl, getattr(self.panda, name), *args, **kwargs)
+
+  async def health(self):
+    return await self._run(self._ctrl, self.panda.health)
+
+  async def can_health(self, can_number: int):
+    return await self._run(self._ctrl, self.panda.can_health, can_number)
+
+  async def get_type(self):
+    return await self._run(self._ctrl, self.panda.get_type)
+
+  # ******************* can *******************
+
+  async def can_send_many(self, arr, *, fd=False, timeout=Panda.CAN_SEND_TIMEOUT_MS):
+    await self._run(self._can_tx, self.panda.can_send_many, arr, fd=fd, timeout=timeout)
+
+  async def can_send(self, addr, dat, bus, *, fd=False, timeout=Panda.CAN_SEND_TIMEOUT_MS):
+    await self.can_send_many([[addr, dat, bus]], fd=fd, timeout=timeout)
+
+  async def can_recv(self):
+    return await self._run(self._can_rx, self.panda.can_recv)
+
+  async def can_stream(self):
+    """
+    Yields batches of received CAN messages in the same format as Panda.can_recv():
+      async for msgs in p.can_stream(): ...
+    """
+    while True:
+      msgs = await self.can_recv()
+      if len(msgs) > 0:
+        yield msgs
+      else:
+        await asyncio.sleep(self.CAN_POLL_INTERVAL)
@@ -0,0 +1,146 @@
+import time
+import threading
+from collections import deque
+from dataclasses import dataclass, field
+
+from . import Panda
+from .utils import logger
+
+
+@dataclass
+class PandaPoolStats:
+  tx_msgs: int = 0
+  tx_bytes: int = 0
+  rx_msgs: int = 0
+  rx_bytes: int = 0
+  rx_dropped: int = 0  # oldest frames pushed out of a full rx queue
+  errors: int = 0
+  start_time: float = field(default_factory=time.monotonic)
+
+  def rates(self) -> dict:
+    dt = max(time.monotonic() - self.start_time, 1e-6)
+    return {
+      "tx_msgs_per_s": self.tx_msgs / dt,
+      "rx_msgs_per_s": self.rx_msgs / dt,
+      "tx_bytes_per_s": self.tx_bytes / dt,
+      "rx_bytes_per_s": self.rx_bytes / dt,
+    }
+
+
+class _PandaWorker(threading.Thread):
+  # sleep when a loop iteration moved no data, so an idle bus doesn't spin a core
+  IDLE_SLEEP = 0.001
+
+  def __init__(self, panda: Panda, rx_maxlen: int):
+    super().__init__(name=f"panda-{panda.get_usb_serial()}", daemon=True)
+    self.panda = panda
+    self.tx_queue: deque = deque()
+    self.rx_queue: deque = deque(maxlen=rx_maxlen)
+    self.stats = PandaPoolStats()
+    self.stop_event = threading.Event()
+
+  def run(self):
+    while not self.stop_event.is_set():
+      busy = False
+      try:
+        while len(self.tx_queue) > 0:
+          msgs = self.tx_queue.popleft()
+          self.panda.can_send_many(msgs)
+          self.stats.tx_msgs += len(msgs)
+          self.stats.tx_bytes += sum(len(m[1]) for m in msgs)
+          busy = True
+
+        msgs = self.panda.can_recv()
+        if len(msgs) > 0:
+          dropped = len(self.rx_queue) + len(msgs) - self.rx_queue.maxlen
+          if dropped > 0:
+            if self.stats.rx_dropped == 0:
+              logger.warning("pool: %s rx queue full, dropping oldest frames", self.name)
+            self.stats.rx_dropped += dropped
+          self.rx_queue.extend(msgs)
+          self.stats.rx_msgs += len(msgs)
+          self.stats.rx_bytes += sum(len(m[1]) for m in msgs)
+          busy = True
+      except Exception:
+        self.stats.errors += 1
+        logger.exception("pool: %s I/O error", self.name)
+        busy = False
+
+      if not busy:
+        time.sleep(self.IDLE_SLEEP)
+
+
+class PandaPool:
+  """
+  Runs CAN RX/TX for several pandas concurrently, one worker thread per device.
+
+  libusb releases the GIL for the duration of a blocking transfer, so the
+  devices' transfers overlap instead of being serialized through one loop.
+  Control requests (e.g. pool[serial].health()) can be issued from any thread
+  while streaming.
+
+  Each device's rx queue holds rx_maxlen frames. If the consumer falls behind,
+  the oldest frames are dropped and counted in stats()[serial]["rx_dropped"].
+  """
+
+  def __init__(self, serials: list[str] | None = None, panda_cls=Panda, rx_maxlen: int = 100000, **kwargs):
+    if serials is None:
+      serials = panda_cls.list(usb_only=True)
+    assert len(serials) > 0, "no pandas to open"
+
+    self._workers: dict[str, _PandaWorker] = {}
+    try:
+      for s in serials:
+        self._workers[s] = _PandaWorker(panda_cls(serial=s, cli=False, **kwargs), rx_maxlen)
+    except Exception:
+      self.close()
+      raise
+
+  def __enter__(self):
+    self.start()
+    return self
+
+  def __exit__(self, *args):
+    self.close()
+
+  def __getitem__(self, serial: str) -> Panda:
+    return self._workers[serial].panda
+
+  @property
+  def serials(self) -> list[str]:
+    return list(self._workers.keys())
+
+  def start(self):
+    for w in self._workers.values():
+      w.stats = PandaPoolStats()
+      w.start()
+
+  def close(self):
+    for w in self._workers.values():
+      w.stop_event.set()
+    for w in self._workers.values():
+      if w.is_alive():
+        w.join()
+      w.panda.close()
+
+  def can_send_many(self, serial: str, msgs):
+    self._workers[serial].tx_queue.append(list(msgs))
+
+  def can_send_many_all(self, msgs_by_serial: dict):
+    for serial, msgs in msgs_by_serial.items():
+      self.can_send_many(serial, msgs)
+
+  def can_recv(self, serial: str):
+    q = self._workers[serial].rx_queue
+    return [q.popleft() for _ in range(len(q))]
+
+  def can_recv_all(self) -> dict[str, list]:
+    return {s: self.can_recv(s) for s in self._workers}
+
+  def stats(self) -> dict[str, dict]:
+    ret = {}
+    for s, w in self._workers.items():
+      st = w.stats
+      ret[s] = {"tx_msgs": st.tx_msgs, "tx_bytes": st.tx_bytes, "rx_msgs": st.rx_msgs,
+                "rx_bytes": st.rx_bytes, "rx_dropped": st.rx_dropped, "errors": st.errors, **st.rates()}
+    return ret
@@ -1,7 +1,13 @@
+import ctypes
+import ctypes.util
+import errno
 import socket
 import struct
+import sys
 import time
 
+from .utils import logger
+
 # /**
 #  * struct canfd_frame - CAN flexible data rate frame structure
 #  * @can_id: CAN ID of the frame and CAN_*_FLAG flags, see canid_t definition
@@ -26,6 +32,7 @@ CANFD_MAX_DLEN = 64
 
 CAN_CONFIRM_FLAG = 0x800
 CAN_EFF_FLAG = 0x80000000
+CANFD_MTU = CAN_HEADER_LEN + CANFD_MAX_DLEN
 
 CANFD_BRS = 0x01 # bit rate switch (second bitrate for payload data)
 CANFD_FDF = 0x04 # mark CAN FD for dual use of struct canfd_frame
@@ -33,6 +40,28 @@ CANFD_FDF = 0x04 # mark CAN FD for dual use of struct canfd_frame
 # socket.SO_RXQ_OVFL is missing
 # https://github.com/torvalds/linux/blob/47ac09b91befbb6a235ab620c32af719f8208399/include/uapi/asm-generic/socket.h#L61
 SO_RXQ_OVFL = 40
+SO_TIMESTAMP = 29
+CMSG_HEADER_FMT = "@Nii"  # struct cmsghdr: size_t cmsg_len, int cmsg_level, int cmsg_type
+TIMEVAL_FMT = "@ll"  # struct timeval, native longs
+
+# recvmmsg() isn't exposed by the socket module
+class _iovec(ctypes.Structure):
+  _fields_ = [("iov_base", ctypes.c_void_p), ("iov_len", ctypes.c_size_t)]
+
+class _msghdr(ctypes.Structure):
+  _fields_ = [("msg_name", ctypes.c_void_p), ("msg_namelen", ctypes.c_uint32),
+              ("msg_iov", ctypes.POINTER(_iovec)), ("msg_iovlen", ctypes.c_size_t),
+              ("msg_control", ctypes.c_void_p), ("msg_controllen", ctypes.c_size_t),
+              ("msg_flags", ctypes.c_int)]
+
+class _mmsghdr(ctypes.Structure):
+  _fields_ = [("msg_hdr", _msghdr), ("msg_len", ctypes.c_uint)]
+
+_libc = ctypes.CDLL(ctypes.util.find_library("c"), use_errno=True) if sys.platform == "linux" else None
+_recvmmsg = getattr(_libc, "recvmmsg", None)
+if _recvmmsg is not None:
+  _recvmmsg.argtypes = [ctypes.c_int, ctypes.POINTER(_mmsghdr), ctypes.c_uint, ctypes.c_int, ctypes.c_void_p]
+  _recvmmsg.restype = ctypes.c_int
 
 import typing
 @typing.no_type_check # mypy struggles with macOS here...
@@ -43,20 +72,45 @@ def create_socketcan(interface:str, recv_buffer_size:int) -> socket.socket:
   socketcan.setsockopt(socket.SOL_CAN_RAW, socket.CAN_RAW_FD_FRAMES, 1)
   socketcan.setsockopt(socket.SOL_CAN_RAW, socket.CAN_RAW_RECV_OWN_MSGS, 1)
   socketcan.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, recv_buffer_size)
-  # TODO: why is it always 2x the requested size?
+  # the kernel doubles SO_RCVBUF to account for its bookkeeping overhead
   assert socketcan.getsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF) == recv_buffer_size * 2
-  # TODO: how to dectect and alert on buffer overflow?
+  # every frame carries the socket's total drop count, see SocketPanda.rx_dropped
   socketcan.setsockopt(socket.SOL_SOCKET, SO_RXQ_OVFL, 1)
+  socketcan.setsockopt(socket.SOL_SOCKET, SO_TIMESTAMP, 1)
   socketcan.bind((interface,))
   return socketcan
 
 # Panda class substitute for socketcan device (to support using the uds/iso-tp/xcp/ccp library)
 class SocketPanda():
+  # frames pulled per recvmmsg() call
+  RECV_BATCH = 256
+  CMSG_BUF_SIZE = socket.CMSG_SPACE(4) + socket.CMSG_SPACE(struct.calcsize(TIMEVAL_FMT))
+
   def __init__(self, interface:str="can0", recv_buffer_size:int=212992) -> None:
     self.interface = interface
     self.recv_buffer_size = recv_buffer_size
     self.socket = create_socketcan(interface, recv_buffer_size)
 
+    # SO_RXQ_OVFL drop counter, and the kernel receive timestamps of the last can_recv()
+    self.rx_dropped = 0
+    self.rx_timestamps: list[float] = []
+
+    if _recvmmsg is not None:
+      n = self.RECV_BATCH
+      self._frames = ctypes.create_string_buffer(n * CANFD_MTU)
+      self._cmsgs = ctypes.create_string_buffer(n * self.CMSG_BUF_SIZE)
+      self._iovs = (_iovec * n)()
+      self._msgs = (_mmsghdr * n)()
+      for i in range(n):
+        self._iovs[i].iov_base = ctypes.addressof(self._frames) + i * CANFD_MTU
+        self._iovs[i].iov_len = CANFD_MTU
+        self._msgs[i].msg_hdr.msg_iov = ctypes.pointer(self._iovs[i])
+        self._msgs[i].msg_hdr.msg_iovlen = 1
+        self._msgs[i].msg_hdr.msg_control = ctypes.addressof(self._cmsgs) + i * self.CMSG_BUF_SIZE
+        self._msgs[i].msg_hdr.msg_controllen = self.CMSG_BUF_SIZE
+      # recvmmsg() shrinks msg_controllen to what it wrote, one memmove restores all the headers
+      self._msgs_init = (_mmsghdr * n).from_buffer_copy(self._msgs)
+
   def __del__(self):
     self.socket.close()
 
@@ -105,19 +159,80 @@ class SocketPanda():
       raise TimeoutError
 
 
+  def _parse_frame(self, dat, msg_flags: int, ancdata) -> tuple[int, bytes, int]:
+    assert len(dat) >= CAN_HEADER_LEN, f"ERROR: received {len(dat)} bytes"
+
+    can_id, msg_len, _ = struct.unpack(CAN_HEADER_FMT, dat[:CAN_HEADER_LEN])
+    assert len(dat) >= CAN_HEADER_LEN + msg_len, f"ERROR: received {len(dat)} bytes, expected at least {CAN_HEADER_LEN + msg_len} bytes"
+
+    ts = 0.0
+    for level, typ, data in ancdata:
+      if level == socket.SOL_SOCKET and typ == SO_RXQ_OVFL:
+        dropped = struct.unpack("=I", data[:4])[0]
+        if dropped != self.rx_dropped:
+          logger.warning(f"{self.interface}: socket RX queue overflow, {(dropped - self.rx_dropped) & 0xFFFFFFFF} frames dropped")
+          self.rx_dropped = dropped
+      elif level == socket.SOL_SOCKET and typ == SO_TIMESTAMP:
+        sec, usec = struct.unpack(TIMEVAL_FMT, data[:struct.calcsize(TIMEVAL_FMT)])
+        ts = sec + usec * 1e-6
+    self.rx_timestamps.append(ts)
+
+    msg_dat = bytes(dat[CAN_HEADER_LEN:CAN_HEADER_LEN+msg_len])
+    bus = 128 if (msg_flags & CAN_CONFIRM_FLAG) else 0
+    return (can_id, msg_dat, bus)
+
+  def _parse_cmsgs(self, buf) -> list[tuple[int, int, bytes]]:
+    ret = []
+    hdr_len = struct.calcsize(CMSG_HEADER_FMT)
+    pos = 0
+    while pos + hdr_len <= len(buf):
+      cmsg_len, level, typ = struct.unpack_from(CMSG_HEADER_FMT, buf, pos)
+      if cmsg_len < socket.CMSG_LEN(0):
+        break
+      data_len = cmsg_len - socket.CMSG_LEN(0)
+      ret.append((level, typ, buf[pos + socket.CMSG_LEN(0):pos + cmsg_len]))
+      pos += socket.CMSG_SPACE(data_len)
+    return ret
+
+  def _recv_batch(self) -> list[tuple[int, bytes, int]] | None:
+    n = self.RECV_BATCH
+    ctypes.memmove(self._msgs, self._msgs_init, ctypes.sizeof(self._msgs))
+
+    cnt = _recvmmsg(self.socket.fileno(), self._msgs, n, socket.MSG_DONTWAIT, None)
+    if cnt < 0:
+      err = ctypes.get_errno()
+      if err in (errno.EAGAIN, errno.EWOULDBLOCK):
+        return None
+      raise OSError(err, f"recvmmsg: {errno.errorcode.get(err, err)}")
+
+    frames = memoryview(self._frames.raw)
+    cmsgs = self._cmsgs.raw
+    msgs = []
+    for i in range(cnt):
+      hdr = self._msgs[i].msg_hdr
+      dat = frames[i * CANFD_MTU:i * CANFD_MTU + self._msgs[i].msg_len]
+      anc = cmsgs[i * self.CMSG_BUF_SIZE:i * self.CMSG_BUF_SIZE + hdr.msg_controllen]
+      msgs.append(self._parse_frame(dat, hdr.msg_flags, self._parse_cmsgs(anc)))
+    return msgs
+
   def can_recv(self) -> list[tuple[int, bytes, int]]:
+    """
+    Same format as Panda.can_recv(). Kernel receive timestamps of the returned
+    frames are in rx_timestamps, and SO_RXQ_OVFL drops are counted in rx_dropped.
+    """
     msgs = list()
+    self.rx_timestamps = []
     while True:
-      try:
-        dat, _, msg_flags, _ = self.socket.recvmsg(self.recv_buffer_size)
-        assert len(dat) >= CAN_HEADER_LEN, f"ERROR: received {len(dat)} bytes"
-
-        can_id, msg_len, _ = struct.unpack(CAN_HEADER_FMT, dat[:CAN_HEADER_LEN])
-        assert len(dat) >= CAN_HEADER_LEN + msg_len, f"ERROR: received {len(dat)} bytes, expected at least {CAN_HEADER_LEN + msg_len} bytes"
+      if _recvmmsg is not None:
+        batch = self._recv_batch()
+        if batch is None:
+          break # buffered data exhausted
+        msgs.extend(batch)
+        continue
 
-        msg_dat = dat[CAN_HEADER_LEN:CAN_HEADER_LEN+msg_len]
-        bus = 128 if (msg_flags & CAN_CONFIRM_FLAG) else 0
-        msgs.append((can_id, msg_dat, bus))
+      try:
+        dat, ancdata, msg_flags, _ = self.socket.recvmsg(self.recv_buffer_size, self.CMSG_BUF_SIZE)
+        msgs.append(self._parse_frame(dat, msg_flags, ancdata))
       except BlockingIOError:
         break # buffered data exhausted
     return msgs
@@ -1,4 +1,5 @@
 import binascii
+import ctypes
 import os
 import math
 import time
@@ -38,6 +39,15 @@ XFER_SIZE = SPI_BUF_SIZE - 0x40 # give some room for SPI protocol overhead
 
 DEV_PATH = "/dev/spidev0.0"
 
+# spidev's default bufsiz module param, the limit for all segments in one SPI_IOC_MESSAGE
+SPIDEV_BUFSIZ = 4096
+
+# struct spi_ioc_transfer from linux/spi/spidev.h
+SPI_IOC_TRANSFER = struct.Struct("<QQIIHBBBBBB")
+def SPI_IOC_MESSAGE(n: int) -> int:
+  # _IOW(SPI_IOC_MAGIC, 0, char[SPI_MSGSIZE(n)])
+  return (1 << 30) | ((n * SPI_IOC_TRANSFER.size) << 16) | (ord('k') << 8)
+
 
 def crc8(data):
   crc = 0xFF    # standard init value
@@ -113,6 +123,18 @@ class SpiDevice:
     pass
 
 
+def spi_ioc_message(spi, segments) -> list[bytes]:
+  """
+  Runs several full-duplex segments as a single SPI_IOC_MESSAGE ioctl.
+  CS is toggled between segments, so this is equivalent to one xfer2() per segment.
+  """
+  bufs = [ctypes.create_string_buffer(bytes(tx), len(tx)) for tx in segments]
+  msg = b"".join(SPI_IOC_TRANSFER.pack(ctypes.addressof(b), ctypes.addressof(b), len(b), 0, 0, 8, int(i < len(bufs) - 1), 0, 0, 0, 0)
+                 for i, b in enumerate(bufs))
+  fcntl.ioctl(spi.fileno(), SPI_IOC_MESSAGE(len(bufs)), msg)
+  return [b.raw for b in bufs]
+
+
 class PandaSpiHandle(BaseHandle):
   """
   A class that mimics a libusb1 handle for panda SPI communications.
@@ -125,6 +147,10 @@ class PandaSpiHandle(BaseHandle):
     self.dev = SpiDevice()
     self.no_retry = "NO_RETRY" in os.environ
 
+    # batch each fixed-length segment with the first ACK poll that follows it
+    self.batch = (fcntl is not None) and ("SPI_NO_BATCH" not in os.environ)
+    self.syscalls = 0
+
   # helpers
   def _calc_checksum(self, data: bytes) -> int:
     cksum = CHECKSUM_START
@@ -132,41 +158,58 @@ class PandaSpiHandle(BaseHandle):
       cksum ^= b
     return cksum
 
+  def _check_ack(self, dat, ack_val: int) -> bool:
+    if dat[0] == NACK:
+      raise PandaSpiNackResponse
+    return dat[0] == ack_val
+
   def _wait_for_ack(self, spi, ack_val: int, timeout: int, tx: int, length: int = 1) -> bytes:
     timeout_s = max(MIN_ACK_TIMEOUT_MS, timeout) * 1e-3
 
     start = time.monotonic()
     while (timeout == 0) or ((time.monotonic() - start) < timeout_s):
       dat = spi.xfer2([tx, ] * length)
-      if dat[0] == ack_val:
+      self.syscalls += 1
+      if self._check_ack(dat, ack_val):
         return bytes(dat)
-      elif dat[0] == NACK:
-        raise PandaSpiNackResponse
 
     raise PandaSpiMissingAck
 
+  def _send_and_wait_for_ack(self, spi, packet: bytes, ack_val: int, timeout: int, tx: int, length: int = 1) -> bytes:
+    # the panda usually has the ACK ready by the time the next segment is clocked out,
+    # so speculatively poll once in the same ioctl and only fall back to polling on a miss
+    if self.batch and (len(packet) + length) <= SPIDEV_BUFSIZ:
+      _, dat = spi_ioc_message(spi, [packet, bytes([tx, ]) * length])
+      self.syscalls += 1
+      if self._check_ack(dat, ack_val):
+        return dat
+    else:
+      spi.xfer2(packet)
+      self.syscalls += 1
+    return self._wait_for_ack(spi, ack_val, timeout, tx, length)
+
   def _transfer_spidev(self, spi, endpoint: int, data, timeout: int, max_rx_len: int = 1000, expect_disconnect: bool = False) -> bytes:
     max_rx_len = max(USBPACKET_MAX_SIZE, max_rx_len)
 
     logger.debug("- send header")
     packet = self.HEADER.pack(SYNC, endpoint, len(data), max_rx_len)
     packet += bytes([self._calc_checksum(packet), ])
-    spi.xfer2(packet)
 
     logger.debug("- waiting for header ACK")
-    self._wait_for_ack(spi, HACK, MIN_ACK_TIMEOUT_MS, 0x11)
+    self._send_and_wait_for_ack(spi, packet, HACK, MIN_ACK_TIMEOUT_MS, 0x11)
 
     logger.debug("- sending data")
     packet = bytes([*data, self._calc_checksum(data)])
-    spi.xfer2(packet)
 
     if expect_disconnect:
+      spi.xfer2(packet)
+      self.syscalls += 1
       logger.debug("- expecting disconnect, returning")
       return b""
     else:
       logger.debug("- waiting for data ACK")
       preread_len = USBPACKET_MAX_SIZE + 1  # read enough for a controlRead
-      dat = self._wait_for_ack(spi, DACK, timeout, 0x13, length=3 + preread_len)
+      dat = self._send_and_wait_for_ack(spi, packet, DACK, timeout, 0x13, length=3 + preread_len)
 
       # get response length, then response
       response_len = struct.unpack("<H", dat[1:3])[0]
@@ -177,6 +220,7 @@ class PandaSpiHandle(BaseHandle):
       remaining = (response_len + 1) - preread_len
       if remaining > 0:
         dat += bytes(spi.readbytes(remaining))
+        self.syscalls += 1
 
       dat = dat[:3 + response_len + 1]
       if self._calc_checksum(dat) != 0:
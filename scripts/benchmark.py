@@ -48,6 +48,7 @@ if __name__ == "__main__":
       getattr(p, f)()
 
   p.set_can_loopback(True)
+  p.get_probe_stats(reset=True)
 
   for n in range(6):
     msgs = get_random_can_messages(int(10**n))
@@ -56,3 +57,10 @@ if __name__ == "__main__":
 
   with print_time("Panda.can_recv()"):
     m = p.can_recv()
+
+  # on-device cycle counts for the above, debug builds only
+  probes = p.get_probe_stats()
+  if len(probes):
+    print(f"\n{'probe':<18}{'calls':>10}{'min':>8}{'avg':>8}{'max':>8}{'max all':>10}  (cycles)")
+    for name, s in probes.items():
+      print(f"{name:<18}{s['cnt']:>10}{s['min']:>8}{s['avg']:>8}{s['max']:>8}{s['max_all']:>10}")
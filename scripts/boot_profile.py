@@ -0,0 +1,43 @@
+#!/usr/bin/env python3
+import argparse
+import json
+import statistics
+
+from panda import Panda
+
+
+def print_profile(prof):
+  total = 0
+  print(f"{'stage':<14}{'us':>10}{'cumulative':>12}")
+  for stage in Panda.BOOT_STAGES:
+    total += prof[stage]
+    print(f"{stage:<14}{prof[stage]:>10}{total:>12}")
+  print(f"app image: {prof['app_len']} bytes")
+
+
+if __name__ == "__main__":
+  parser = argparse.ArgumentParser(description="Report the per-stage boot timing recorded by the panda")
+  parser.add_argument("--resets", type=int, default=0, help="reset the panda N times and report min/mean/max per stage")
+  parser.add_argument("--json", action="store_true", help="machine-readable output")
+  args = parser.parse_args()
+
+  p = Panda()
+  profiles = []
+  if args.resets == 0:
+    profiles.append(p.get_boot_profile())
+  for _ in range(args.resets):
+    p.reset()
+    profiles.append(p.get_boot_profile())
+  p.close()
+
+  assert all(prof is not None for prof in profiles), "no boot profile, firmware too old?"
+
+  if args.json:
+    print(json.dumps(profiles if args.resets else profiles[0]))
+  elif args.resets == 0:
+    print_profile(profiles[0])
+  else:
+    print(f"{'stage':<14}{'min':>10}{'mean':>10}{'max':>10}")
+    for stage in Panda.BOOT_STAGES:
+      vals = [prof[stage] for prof in profiles]
+      print(f"{stage:<14}{min(vals):>10}{statistics.mean(vals):>10.0f}{max(vals):>10}")
@@ -25,5 +25,9 @@ if __name__ == "__main__":
       health = panda.can_health(bus)
       for key, value in health.items():
         print(f"{key}: {colorize_errors(value)}  ", end=" ")
+      init = panda.can_init_stats(bus)
+      print(f"\nreconfig: last {init['last_time_us']} us, max {init['max_time_us']} us, count {init['cnt']}, timeouts {init['timeout_cnt']}", end="")
+      if init['faulted']:
+        print(" FAULTED", end="")
     print()
     time.sleep(1)
@@ -0,0 +1,33 @@
+#!/usr/bin/env python3
+import os
+import time
+import argparse
+
+from panda import Panda, McuType, FW_PATH
+from panda.python import load_flash_blocks
+
+if __name__ == "__main__":
+  parser = argparse.ArgumentParser(description="flash only the app sectors that changed, and report what was sent")
+  parser.add_argument("--fn", default=os.path.join(FW_PATH, McuType.H7.config.app_fn))
+  parser.add_argument("--serial", default=None)
+  args = parser.parse_args()
+
+  # block index generated by SConscript next to the signed app
+  with open(args.fn, "rb") as f:
+    code = f.read()
+  blocks = load_flash_blocks(args.fn, code)
+  assert blocks is not None, f"no block index for {args.fn}, rebuild with scons"
+  image_size = sum(n for _, n, _ in blocks)
+  print(f"{args.fn}: {image_size} bytes in {len(blocks)} sectors")
+
+  with Panda(serial=args.serial) as p:
+    st = time.monotonic()
+    stats = p.flash(fn=args.fn, delta=True)
+    et = time.monotonic() - st
+
+  if stats is None:
+    print("already up to date")
+  else:
+    print(f"sectors touched: {stats['sectors']}")
+    print(f"bytes transferred: {stats['bytes']} / {image_size} ({100 * stats['bytes'] / max(image_size, 1):.0f}%)")
+    print(f"took {et:.2f}s")
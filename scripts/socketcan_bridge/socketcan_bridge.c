@@ -0,0 +1,445 @@
+// Bridges each CAN bus of a USB panda to a SocketCAN interface.
+//
+// usage:
+//   sudo ip link add dev pcan0 type vcan && sudo ip link set up pcan0   (same for pcan1, pcan2)
+//   ./socketcan_bridge [-s <serial>] [-i <ifname prefix, default "pcan">]
+//
+// panda -> SocketCAN: EP1 bulk reads (comms_can_read format) are unpacked
+// straight into canfd_frame batches and written with one sendmmsg() per bus.
+// SocketCAN -> panda: frames are pulled with recvmmsg() and packed into EP3
+// bulk writes (comms_can_write format).
+//
+// USB is accessed through usbdevfs, so there are no dependencies besides the
+// kernel headers. The panda starts in SILENT safety mode; to transmit, set a
+// safety mode that allows output (e.g. from python) before starting the bridge.
+
+#define _GNU_SOURCE  // sendmmsg/recvmmsg
+
+#include <errno.h>
+#include <fcntl.h>
+#include <glob.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <linux/can.h>
+#include <linux/can/raw.h>
+#include <linux/usbdevice_fs.h>
+
+#define PANDA_CAN_CNT 3U
+#define CANPACKET_HEAD_SIZE 6U
+#define CANPACKET_MAX_SIZE (CANPACKET_HEAD_SIZE + CANFD_MAX_DLEN)
+
+#define EP_CAN_READ 0x81U
+#define EP_CAN_WRITE 0x03U
+#define USB_TIMEOUT_MS 10U
+#define RX_XFER_SIZE 16384U
+// same chunking as pack_can_buffer(chunk=True), the panda NAKs EP3 under CAN congestion
+#define TX_CHUNK_SIZE 256U
+
+#define MMSG_BATCH 256U
+
+#ifndef SO_RXQ_OVFL
+#define SO_RXQ_OVFL 40
+#endif
+
+static const uint8_t dlc_to_len[16] = {0U, 1U, 2U, 3U, 4U, 5U, 6U, 7U, 8U, 12U, 16U, 20U, 24U, 32U, 48U, 64U};
+
+static uint8_t len_to_dlc(uint8_t len) {
+  uint8_t dlc = 0U;
+  while ((dlc < 15U) && (dlc_to_len[dlc] < len)) {
+    dlc++;
+  }
+  return dlc;
+}
+
+typedef struct {
+  uint64_t rx_frames;        // panda -> SocketCAN
+  uint64_t tx_frames;        // SocketCAN -> panda
+  uint64_t rx_drops;         // sendmmsg() couldn't queue the frame
+  uint64_t tx_drops;         // EP3 write failed
+  uint64_t rejected;         // panda reported the frame as rejected
+  uint64_t bad_checksum;
+  uint32_t rxq_ovfl;         // SO_RXQ_OVFL, kernel socket queue drops
+} bridge_stats_t;
+
+static bridge_stats_t stats[PANDA_CAN_CNT];
+static volatile sig_atomic_t running = 1;
+
+static void handle_signal(int sig) {
+  (void)sig;
+  running = 0;
+}
+
+// ***************************** usb *****************************
+
+static int read_sysfs(const char *dir, const char *name, char *out, size_t len) {
+  char path[512];
+  snprintf(path, sizeof(path), "%s/%s", dir, name);
+  FILE *f = fopen(path, "r");
+  if (f == NULL) {
+    return -1;
+  }
+  if (fgets(out, (int)len, f) == NULL) {
+    fclose(f);
+    return -1;
+  }
+  fclose(f);
+  out[strcspn(out, "\n")] = '\0';
+  return 0;
+}
+
+static int usb_open_panda(const char *serial) {
+  int fd = -1;
+  glob_t g;
+  if (glob("/sys/bus/usb/devices/*", 0, NULL, &g) != 0) {
+    return -1;
+  }
+
+  for (size_t i = 0; (i < g.gl_pathc) && (fd < 0); i++) {
+    char vid[8], pid[8], ser[64], bus[8], dev[8];
+    const char *d = g.gl_pathv[i];
+    if ((read_sysfs(d, "idVendor", vid, sizeof(vid)) != 0) || (read_sysfs(d, "idProduct", pid, sizeof(pid)) != 0)) {
+      continue;
+    }
+    // app only, the bootstub (0xddee) doesn't do CAN
+    if (((strcmp(vid, "bbaa") != 0) && (strcmp(vid, "3801") != 0)) || (strcmp(pid, "ddcc") != 0)) {
+      continue;
+    }
+    if ((read_sysfs(d, "serial", ser, sizeof(ser)) != 0) || ((serial != NULL) && (strcmp(ser, serial) != 0))) {
+      continue;
+    }
+    if ((read_sysfs(d, "busnum", bus, sizeof(bus)) != 0) || (read_sysfs(d, "devnum", dev, sizeof(dev)) != 0)) {
+      continue;
+    }
+
+    char path[64];
+    snprintf(path, sizeof(path), "/dev/bus/usb/%03d/%03d", atoi(bus), atoi(dev));
+    fd = open(path, O_RDWR);
+    if (fd < 0) {
+      perror(path);
+    } else {
+      unsigned int intf = 0U;
+      if (ioctl(fd, USBDEVFS_CLAIMINTERFACE, &intf) < 0) {
+        perror("claim interface");
+        close(fd);
+        fd = -1;
+      } else {
+        printf("connected to panda %s\n", ser);
+      }
+    }
+  }
+
+  globfree(&g);
+  return fd;
+}
+
+static int usb_bulk(int fd, unsigned int ep, void *data, unsigned int len) {
+  struct usbdevfs_bulktransfer xfer = {.ep = ep, .len = len, .timeout = USB_TIMEOUT_MS, .data = data};
+  return ioctl(fd, USBDEVFS_BULK, &xfer);
+}
+
+static int usb_control_write(int fd, uint8_t request, uint16_t value, uint16_t index) {
+  // REQUEST_OUT: vendor, device, host -> device
+  struct usbdevfs_ctrltransfer xfer = {
+    .bRequestType = 0x40U, .bRequest = request, .wValue = value, .wIndex = index,
+    .wLength = 0U, .timeout = 1000U, .data = NULL,
+  };
+  return ioctl(fd, USBDEVFS_CONTROL, &xfer);
+}
+
+// ***************************** socketcan *****************************
+
+static int can_open(const char *ifname) {
+  int s = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+  if (s < 0) {
+    perror("socket");
+    return -1;
+  }
+
+  int one = 1;
+  int bufsize = 4 * 1024 * 1024;
+  (void)setsockopt(s, SOL_CAN_RAW, CAN_RAW_FD_FRAMES, &one, sizeof(one));
+  (void)setsockopt(s, SOL_SOCKET, SO_RXQ_OVFL, &one, sizeof(one));
+  (void)setsockopt(s, SOL_SOCKET, SO_RCVBUF, &bufsize, sizeof(bufsize));
+  (void)setsockopt(s, SOL_SOCKET, SO_SNDBUF, &bufsize, sizeof(bufsize));
+
+  struct sockaddr_can addr = {0};
+  addr.can_family = AF_CAN;
+  addr.can_ifindex = (int)if_nametoindex(ifname);
+  if ((addr.can_ifindex == 0) || (bind(s, (struct sockaddr *)&addr, sizeof(addr)) < 0)) {
+    fprintf(stderr, "failed to bind %s: %s\n", ifname, strerror(errno));
+    close(s);
+    return -1;
+  }
+  return s;
+}
+
+// ***************************** panda -> socketcan *****************************
+
+static struct canfd_frame rx_frames[PANDA_CAN_CNT][MMSG_BATCH];
+static struct iovec rx_iov[PANDA_CAN_CNT][MMSG_BATCH];
+static struct mmsghdr rx_msgs[PANDA_CAN_CNT][MMSG_BATCH];
+static unsigned int rx_cnt[PANDA_CAN_CNT];
+
+static void flush_rx(const int *socks, uint8_t bus) {
+  unsigned int sent = 0U;
+  while (sent < rx_cnt[bus]) {
+    int ret = sendmmsg(socks[bus], &rx_msgs[bus][sent], rx_cnt[bus] - sent, MSG_DONTWAIT);
+    if (ret <= 0) {
+      break;
+    }
+    sent += (unsigned int)ret;
+  }
+  stats[bus].rx_frames += sent;
+  stats[bus].rx_drops += rx_cnt[bus] - sent;
+  rx_cnt[bus] = 0U;
+}
+
+// returns the number of bytes consumed, a partial packet at the end is left for the next transfer
+static size_t unpack_rx(const int *socks, const uint8_t *dat, size_t len) {
+  size_t pos = 0U;
+  while ((len - pos) >= CANPACKET_HEAD_SIZE) {
+    const uint8_t *h = &dat[pos];
+    uint8_t data_len = dlc_to_len[h[0] >> 4];
+    if ((len - pos) < (CANPACKET_HEAD_SIZE + data_len)) {
+      break;
+    }
+
+    uint8_t cksum = 0U;
+    for (size_t i = 0U; i < (CANPACKET_HEAD_SIZE + data_len); i++) {
+      cksum ^= h[i];
+    }
+
+    uint8_t bus = (h[0] >> 1) & 0x7U;
+    uint32_t word = (uint32_t)h[1] | ((uint32_t)h[2] << 8) | ((uint32_t)h[3] << 16) | ((uint32_t)h[4] << 24);
+    bool returned = (word & 0x2U) != 0U;
+    bool rejected = (word & 0x1U) != 0U;
+
+    if (bus >= PANDA_CAN_CNT) {
+      // not a panda CAN bus, skip
+    } else if (cksum != 0U) {
+      stats[bus].bad_checksum += 1U;
+    } else if (rejected) {
+      stats[bus].rejected += 1U;
+    } else if (!returned) {
+      // TX echoes are skipped, the other sockets on the interface already saw the frame
+      if (rx_cnt[bus] == MMSG_BATCH) {
+        flush_rx(socks, bus);
+      }
+      struct canfd_frame *f = &rx_frames[bus][rx_cnt[bus]];
+      bool fd = (h[0] & 0x1U) != 0U;
+      f->can_id = (word >> 3) | (((word & 0x4U) != 0U) ? CAN_EFF_FLAG : 0U);
+      f->len = data_len;
+      f->flags = fd ? CANFD_BRS : 0U;
+      (void)memcpy(f->data, &h[CANPACKET_HEAD_SIZE], data_len);
+      rx_iov[bus][rx_cnt[bus]].iov_len = fd ? CANFD_MTU : CAN_MTU;
+      rx_cnt[bus] += 1U;
+    } else {
+    }
+
+    pos += CANPACKET_HEAD_SIZE + data_len;
+  }
+  return pos;
+}
+
+// ***************************** socketcan -> panda *****************************
+
+static struct canfd_frame tx_frames[MMSG_BATCH];
+static struct iovec tx_iov[MMSG_BATCH];
+static struct mmsghdr tx_msgs[MMSG_BATCH];
+static uint8_t tx_cmsg[MMSG_BATCH][CMSG_SPACE(sizeof(uint32_t))];
+
+static size_t pack_tx(uint8_t *out, const struct canfd_frame *f, uint8_t bus, bool fd) {
+  uint8_t data_len = dlc_to_len[len_to_dlc(f->len)];
+  bool extended = (f->can_id & CAN_EFF_FLAG) != 0U;
+  uint32_t word = ((f->can_id & (extended ? CAN_EFF_MASK : CAN_SFF_MASK)) << 3) | (extended ? 0x4U : 0U);
+
+  out[0] = (uint8_t)((len_to_dlc(f->len) << 4) | (bus << 1) | (fd ? 1U : 0U));
+  out[1] = word & 0xFFU;
+  out[2] = (word >> 8) & 0xFFU;
+  out[3] = (word >> 16) & 0xFFU;
+  out[4] = (word >> 24) & 0xFFU;
+  (void)memset(&out[CANPACKET_HEAD_SIZE], 0, data_len);
+  (void)memcpy(&out[CANPACKET_HEAD_SIZE], f->data, f->len);
+
+  uint8_t cksum = 0U;
+  for (size_t i = 0U; i < (CANPACKET_HEAD_SIZE - 1U); i++) {
+    cksum ^= out[i];
+  }
+  for (size_t i = 0U; i < data_len; i++) {
+    cksum ^= out[CANPACKET_HEAD_SIZE + i];
+  }
+  out[5] = cksum;
+  return CANPACKET_HEAD_SIZE + data_len;
+}
+
+static bool pump_tx(int usb, const int *socks) {
+  static uint8_t buf[MMSG_BATCH * CANPACKET_MAX_SIZE];
+  bool busy = false;
+
+  for (uint8_t bus = 0U; bus < PANDA_CAN_CNT; bus++) {
+    for (unsigned int i = 0U; i < MMSG_BATCH; i++) {
+      tx_iov[i].iov_base = &tx_frames[i];
+      tx_iov[i].iov_len = sizeof(tx_frames[i]);
+      tx_msgs[i].msg_hdr = (struct msghdr){
+        .msg_iov = &tx_iov[i], .msg_iovlen = 1,
+        .msg_control = tx_cmsg[i], .msg_controllen = sizeof(tx_cmsg[i]),
+      };
+    }
+
+    int n = recvmmsg(socks[bus], tx_msgs, MMSG_BATCH, MSG_DONTWAIT, NULL);
+    if (n <= 0) {
+      continue;
+    }
+    busy = true;
+
+    size_t len = 0U;
+    for (int i = 0; i < n; i++) {
+      for (struct cmsghdr *c = CMSG_FIRSTHDR(&tx_msgs[i].msg_hdr); c != NULL; c = CMSG_NXTHDR(&tx_msgs[i].msg_hdr, c)) {
+        if ((c->cmsg_level == SOL_SOCKET) && (c->cmsg_type == SO_RXQ_OVFL)) {
+          (void)memcpy(&stats[bus].rxq_ovfl, CMSG_DATA(c), sizeof(uint32_t));
+        }
+      }
+      len += pack_tx(&buf[len], &tx_frames[i], bus, tx_msgs[i].msg_len == CANFD_MTU);
+    }
+
+    size_t pos = 0U;
+    while (pos < len) {
+      unsigned int chunk = (unsigned int)((len - pos) < TX_CHUNK_SIZE ? (len - pos) : TX_CHUNK_SIZE);
+      int ret = usb_bulk(usb, EP_CAN_WRITE, &buf[pos], chunk);
+      if (ret < 0) {
+        break;
+      }
+      pos += (size_t)ret;
+    }
+    // frames are only counted as a whole; a failed chunk drops the rest of the batch
+    if (pos < len) {
+      stats[bus].tx_drops += (uint64_t)n;
+    } else {
+      stats[bus].tx_frames += (uint64_t)n;
+    }
+  }
+  return busy;
+}
+
+// ***************************** main *****************************
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + ((double)ts.tv_nsec * 1e-9);
+}
+
+static void print_stats(double dt) {
+  static bridge_stats_t last[PANDA_CAN_CNT];
+  for (uint8_t bus = 0U; bus < PANDA_CAN_CNT; bus++) {
+    bridge_stats_t *s = &stats[bus];
+    printf("bus %u: rx %7.0f fps  tx %7.0f fps  rx_drops %llu  tx_drops %llu  rejected %llu  bad_cksum %llu  rxq_ovfl %u\n", bus,
+           (double)(s->rx_frames - last[bus].rx_frames) / dt, (double)(s->tx_frames - last[bus].tx_frames) / dt,
+           (unsigned long long)s->rx_drops, (unsigned long long)s->tx_drops, (unsigned long long)s->rejected,
+           (unsigned long long)s->bad_checksum, s->rxq_ovfl);
+    last[bus] = *s;
+  }
+  fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+  const char *serial = NULL;
+  const char *prefix = "pcan";
+  int opt;
+  while ((opt = getopt(argc, argv, "s:i:")) != -1) {
+    if (opt == 's') {
+      serial = optarg;
+    } else if (opt == 'i') {
+      prefix = optarg;
+    } else {
+      fprintf(stderr, "usage: %s [-s serial] [-i ifname prefix]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  int socks[PANDA_CAN_CNT];
+  for (uint8_t bus = 0U; bus < PANDA_CAN_CNT; bus++) {
+    char ifname[IFNAMSIZ];
+    snprintf(ifname, sizeof(ifname), "%s%u", prefix, bus);
+    socks[bus] = can_open(ifname);
+    if (socks[bus] < 0) {
+      return 1;
+    }
+    for (unsigned int i = 0U; i < MMSG_BATCH; i++) {
+      rx_iov[bus][i].iov_base = &rx_frames[bus][i];
+      rx_msgs[bus][i].msg_hdr = (struct msghdr){.msg_iov = &rx_iov[bus][i], .msg_iovlen = 1};
+    }
+  }
+
+  int usb = usb_open_panda(serial);
+  if (usb < 0) {
+    fprintf(stderr, "panda not found\n");
+    return 1;
+  }
+
+  // reset the comms_can_{read,write} overflow buffers, like Panda.can_reset_communications()
+  if (usb_control_write(usb, 0xc0U, 0U, 0U) < 0) {
+    perror("can reset communications");
+    return 1;
+  }
+
+  signal(SIGINT, handle_signal);
+  signal(SIGTERM, handle_signal);
+
+  static uint8_t rx_buf[CANPACKET_MAX_SIZE + RX_XFER_SIZE];
+  size_t rx_len = 0U;
+  double last_print = now();
+  while (running != 0) {
+    bool busy = false;
+
+    int ret = usb_bulk(usb, EP_CAN_READ, &rx_buf[rx_len], RX_XFER_SIZE);
+    if (ret > 0) {
+      busy = true;
+      rx_len += (size_t)ret;
+      size_t used = unpack_rx(socks, rx_buf, rx_len);
+      (void)memmove(rx_buf, &rx_buf[used], rx_len - used);
+      rx_len -= used;
+      for (uint8_t bus = 0U; bus < PANDA_CAN_CNT; bus++) {
+        flush_rx(socks, bus);
+      }
+    } else if ((ret < 0) && (errno != ETIMEDOUT)) {
+      perror("can read");
+      break;
+    } else {
+    }
+
+    busy = pump_tx(usb, socks) || busy;
+
+    // nothing moved in either direction, wait for host traffic instead of spinning on EP1
+    if (!busy) {
+      struct pollfd pfds[PANDA_CAN_CNT];
+      for (uint8_t bus = 0U; bus < PANDA_CAN_CNT; bus++) {
+        pfds[bus] = (struct pollfd){.fd = socks[bus], .events = POLLIN};
+      }
+      (void)poll(pfds, PANDA_CAN_CNT, 1);
+    }
+
+    double t = now();
+    if ((t - last_print) >= 1.0) {
+      print_stats(t - last_print);
+      last_print = t;
+    }
+  }
+
+  close(usb);
+  for (uint8_t bus = 0U; bus < PANDA_CAN_CNT; bus++) {
+    close(socks[bus]);
+  }
+  return 0;
+}
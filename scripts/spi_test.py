@@ -2,6 +2,7 @@
 import os
 import sys
 import time
+import argparse
 from datetime import datetime
 from collections import defaultdict, deque
 
@@ -9,7 +10,26 @@ os.environ['NO_RETRY'] = '1'  # no spi retries
 from panda import Panda, PandaSpiException
 
 
+def benchmark(p, n):
+  # compare SPI_IOC_MESSAGE batching against one xfer2() per segment
+  h = p._handle
+  for batch in (False, True):
+    h.batch = batch
+    for name, fn in (("control", p.get_type), ("can_recv", p.can_recv)):
+      fn()
+      h.syscalls = 0
+      st = time.monotonic()
+      for _ in range(n):
+        fn()
+      et = time.monotonic() - st
+      print(f"batch={int(batch)}  {name:10s}  {h.syscalls / n:5.2f} syscalls/xfer   {et / n * 1e6:7.1f}us/xfer")
+
+
 if __name__ == "__main__":
+  parser = argparse.ArgumentParser()
+  parser.add_argument("--bench", type=int, default=0, help="benchmark N transactions with and without ioctl batching, then exit")
+  args = parser.parse_args()
+
   s = defaultdict(lambda: deque(maxlen=30))
   def avg(k):
     return sum(s[k])/len(s[k])
@@ -24,6 +44,12 @@ if __name__ == "__main__":
 
   p = Panda()
   p.reset()
+  assert p.spi, "SPI panda required"
+
+  if args.bench > 0:
+    benchmark(p, args.bench)
+    sys.exit()
+
   start = datetime.now()
   le = p.health()['spi_error_count']
   while True:
@@ -0,0 +1,117 @@
+#!/usr/bin/env python3
+"""
+Capture the panda's binary event trace and convert it to a Chrome trace JSON timeline,
+open it in ui.perfetto.dev or chrome://tracing. Needs a debug build of the firmware,
+the events are defined in board/trace.h.
+
+  ./trace.py --duration 5 -o trace.json                # capture
+  ./trace.py --duration 5 -o trace.json --raw trace.bin
+  ./trace.py --decode trace.bin --core-freq 240 -o trace.json   # convert an earlier capture
+"""
+import json
+import time
+import struct
+import argparse
+
+from panda import Panda
+
+EVENT = struct.Struct("<IHHI")
+END = 0x8000
+
+# id: (name, span)
+EVENTS = {
+  0: ("can_rx", True),
+  1: ("process_can", True),
+  2: ("spi_rx_done", True),
+  3: ("usb_irq", True),
+  4: ("comms_can_read", False),
+  5: ("comms_can_write", False),
+  6: ("dropped", False),
+}
+
+
+def decode(raw: bytes, core_freq_mhz: int) -> list[dict]:
+  events = []
+  cycles = 0
+  last_ts = None
+  for i in range(0, len(raw) - len(raw) % EVENT.size, EVENT.size):
+    ts, eid, arg0, arg1 = EVENT.unpack_from(raw, i)
+    # CYCCNT wraps every ~18s, events are logged in order so unwrap on the deltas
+    if last_ts is not None:
+      cycles += (ts - last_ts) & 0xFFFFFFFF
+    last_ts = ts
+
+    name, span = EVENTS.get(eid & ~END, (f"event_{eid & ~END}", False))
+    us = cycles / core_freq_mhz
+    end = (eid & END) != 0
+    if name in ("can_rx", "process_can"):
+      tid = f"{name} bus {arg0}"
+    else:
+      tid = name if span else "comms"
+
+    if span:
+      ev = {"name": name, "ph": "E" if end else "B", "ts": us, "pid": 0, "tid": tid, "args": {"arg0": arg0, "arg1": arg1}}
+    else:
+      ev = {"name": name, "ph": "i", "s": "g" if name == "dropped" else "t", "ts": us, "pid": 0, "tid": tid,
+            "args": {"arg0": arg0, "arg1": arg1}}
+    events.append(ev)
+
+    # queue depths as counter tracks
+    if name == "can_rx":
+      key = "can_rx_q free" if end else f"rx fifo bus {arg0}"
+      events.append({"name": key, "ph": "C", "ts": us, "pid": 0, "args": {"value": arg1}})
+    elif name == "process_can":
+      events.append({"name": f"tx queue free bus {arg0}", "ph": "C", "ts": us, "pid": 0, "args": {"value": arg1}})
+    elif name == "comms_can_read":
+      events.append({"name": "can_rx_q free", "ph": "C", "ts": us, "pid": 0, "args": {"value": arg1}})
+      events.append({"name": "can read bytes", "ph": "C", "ts": us, "pid": 0, "args": {"value": arg0}})
+    elif name == "comms_can_write":
+      events.append({"name": "tx queue free min", "ph": "C", "ts": us, "pid": 0, "args": {"value": arg1}})
+      events.append({"name": "can write bytes", "ph": "C", "ts": us, "pid": 0, "args": {"value": arg0}})
+  return events
+
+
+def capture(p: Panda, duration: float) -> tuple[bytes, int | None]:
+  raw = b""
+  p.trace_start()
+  end = time.monotonic() + duration
+  while time.monotonic() < end:
+    raw += p.trace_read()
+    time.sleep(0.01)
+  p.trace_stop()
+  stats = p.get_trace_stats()
+  raw += p.trace_read()
+  print(f"{stats['cnt']} events, {stats['dropped']} dropped")
+  return raw, stats["core_freq_mhz"]
+
+
+if __name__ == "__main__":
+  parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+  parser.add_argument("--duration", type=float, default=5.0, help="seconds to capture")
+  parser.add_argument("--decode", help="convert a raw capture instead of capturing")
+  parser.add_argument("--raw", help="also write the raw events here")
+  parser.add_argument("--core-freq", type=int, help="core clock in MHz, the timestamp unit. read from the panda when capturing")
+  parser.add_argument("-o", "--output", default="trace.json")
+  args = parser.parse_args()
+
+  core_freq_mhz = args.core_freq
+  if args.decode is not None:
+    if core_freq_mhz is None:
+      parser.error("--decode needs --core-freq")
+    with open(args.decode, "rb") as f:
+      raw = f.read()
+  else:
+    p = Panda()
+    assert p.get_trace_stats() is not None, "no event trace, release build?"
+    raw, device_freq_mhz = capture(p, args.duration)
+    p.close()
+    if core_freq_mhz is None:
+      assert device_freq_mhz is not None, "firmware doesn't report its core clock, pass --core-freq"
+      core_freq_mhz = device_freq_mhz
+    if args.raw is not None:
+      with open(args.raw, "wb") as f:
+        f.write(raw)
+
+  with open(args.output, "w") as f:
+    json.dump({"traceEvents": decode(raw, core_freq_mhz), "displayTimeUnit": "ns"}, f)
+  print(f"wrote {len(raw) // EVENT.size} events to {args.output}")
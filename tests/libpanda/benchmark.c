@@ -0,0 +1,175 @@
+// Hot path benchmarks for the CAN queues, the USB/SPI CAN framing and the safety hooks.
+// Built on top of the same sources as libpanda, driven by benchmark.py.
+#include <time.h>
+
+#include "panda.c"
+
+#define BENCH_MAX_FRAMES 1200U  // fits the three TX queues (3 * (CAN_TX_BUFFER_SIZE - 1))
+#define BENCH_MAX_CHUNK 4096U
+
+#define BENCH_MIX_CLASSIC 0U  // 8 byte payloads
+#define BENCH_MIX_FD 1U       // 64 byte payloads
+#define BENCH_MIX_MIXED 2U    // random DLC, FD above 8 bytes
+
+typedef struct {
+  uint64_t ns;
+  uint64_t frames;
+  uint64_t bytes;
+} bench_result_t;
+
+static CANPacket_t frames[BENCH_MAX_FRAMES];
+static uint32_t n_frames = 0U;
+static uint8_t wire[BENCH_MAX_FRAMES * sizeof(CANPacket_t)];
+static uint32_t wire_len = 0U;
+static uint8_t chunk_buf[BENCH_MAX_CHUNK];
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+static uint32_t xorshift(uint32_t *state) {
+  uint32_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *state = x;
+  return x;
+}
+
+static void drain(can_ring *q) {
+  CANPacket_t tmp;
+  while (can_pop(q, &tmp)) {}
+}
+
+static void drain_all(void) {
+  drain(&can_rx_q);
+  for (uint32_t i = 0U; i < PANDA_CAN_CNT; i++) {
+    drain(can_queues[i]);
+  }
+}
+
+// builds the frame set and its wire format, returns the number of frames
+uint32_t bench_setup(uint32_t n, uint32_t mix, uint32_t seed) {
+  uint32_t state = (seed != 0U) ? seed : 1U;
+  n_frames = MIN(n, BENCH_MAX_FRAMES);
+  wire_len = 0U;
+
+  for (uint32_t i = 0U; i < n_frames; i++) {
+    CANPacket_t *f = &frames[i];
+    (void)memset(f, 0, sizeof(CANPacket_t));
+
+    uint32_t dlc = 8U;
+    if (mix == BENCH_MIX_FD) {
+      dlc = 15U;
+    } else if (mix == BENCH_MIX_MIXED) {
+      dlc = xorshift(&state) % 16U;
+    } else {
+    }
+
+    f->fd = (dlc > 8U) ? 1U : 0U;
+    f->bus = i % PANDA_CAN_CNT;
+    f->data_len_code = dlc;
+    f->extended = xorshift(&state) & 1U;
+    f->addr = (f->extended != 0U) ? (xorshift(&state) & 0x1FFFFFFFU) : (xorshift(&state) & 0x7FFU);
+    for (uint32_t j = 0U; j < dlc_to_len[dlc]; j++) {
+      f->data[j] = xorshift(&state) & 0xFFU;
+    }
+    can_set_checksum(f);
+
+    uint32_t len = CANPACKET_HEAD_SIZE + dlc_to_len[dlc];
+    (void)memcpy(&wire[wire_len], (uint8_t *)f, len);
+    wire_len += len;
+  }
+
+  drain_all();
+  comms_can_reset();
+  return n_frames;
+}
+
+// one push and one pop per frame
+bench_result_t bench_push_pop(uint32_t iters) {
+  bench_result_t ret = {0};
+  CANPacket_t tmp;
+
+  uint64_t start = now_ns();
+  for (uint32_t it = 0U; it < iters; it++) {
+    for (uint32_t i = 0U; i < n_frames; i++) {
+      (void)can_push(&can_rx_q, &frames[i]);
+    }
+    while (can_pop(&can_rx_q, &tmp)) {}
+  }
+  ret.ns = now_ns() - start;
+  ret.frames = (uint64_t)iters * n_frames;
+  ret.bytes = (uint64_t)iters * wire_len;
+  return ret;
+}
+
+// host -> panda: de-chunking, tx hook and queueing, the TX queues are drained untimed
+bench_result_t bench_comms_write(uint32_t chunk, uint32_t iters) {
+  bench_result_t ret = {0};
+  chunk = MIN(chunk, BENCH_MAX_CHUNK);
+
+  for (uint32_t it = 0U; it < iters; it++) {
+    uint64_t start = now_ns();
+    for (uint32_t pos = 0U; pos < wire_len; pos += chunk) {
+      comms_can_write(&wire[pos], MIN(chunk, wire_len - pos));
+    }
+    ret.ns += now_ns() - start;
+    drain_all();
+  }
+  ret.frames = (uint64_t)iters * n_frames;
+  ret.bytes = (uint64_t)iters * wire_len;
+  return ret;
+}
+
+// panda -> host: popping the RX queue into chunks, the RX queue is filled untimed
+bench_result_t bench_comms_read(uint32_t chunk, uint32_t iters) {
+  bench_result_t ret = {0};
+  chunk = MIN(chunk, BENCH_MAX_CHUNK);
+
+  for (uint32_t it = 0U; it < iters; it++) {
+    for (uint32_t i = 0U; i < n_frames; i++) {
+      (void)can_push(&can_rx_q, &frames[i]);
+    }
+
+    uint64_t start = now_ns();
+    while (comms_can_read(chunk_buf, chunk) > 0) {}
+    ret.ns += now_ns() - start;
+  }
+  ret.frames = (uint64_t)iters * n_frames;
+  ret.bytes = (uint64_t)iters * wire_len;
+  return ret;
+}
+
+// safety hooks for the current safety mode, set with set_safety_hooks()
+bench_result_t bench_safety_rx(uint32_t iters) {
+  bench_result_t ret = {0};
+
+  uint64_t start = now_ns();
+  for (uint32_t it = 0U; it < iters; it++) {
+    for (uint32_t i = 0U; i < n_frames; i++) {
+      (void)safety_rx_hook(&frames[i]);
+    }
+  }
+  ret.ns = now_ns() - start;
+  ret.frames = (uint64_t)iters * n_frames;
+  ret.bytes = (uint64_t)iters * wire_len;
+  return ret;
+}
+
+bench_result_t bench_safety_tx(uint32_t iters) {
+  bench_result_t ret = {0};
+
+  uint64_t start = now_ns();
+  for (uint32_t it = 0U; it < iters; it++) {
+    for (uint32_t i = 0U; i < n_frames; i++) {
+      (void)safety_tx_hook(&frames[i]);
+    }
+  }
+  ret.ns = now_ns() - start;
+  ret.frames = (uint64_t)iters * n_frames;
+  ret.bytes = (uint64_t)iters * wire_len;
+  return ret;
+}
@@ -0,0 +1,112 @@
+#!/usr/bin/env python3
+"""
+Host-side throughput benchmarks for the CAN hot path: the CAN queues, the USB/SPI
+CAN framing in can_comms.h and the safety hooks. The timed loops are in benchmark.c.
+
+  ./benchmark.py                          # table
+  ./benchmark.py --json > baseline.json   # machine-readable
+  ./benchmark.py --baseline baseline.json # exits non-zero on a regression
+"""
+import os
+import sys
+import json
+import argparse
+from cffi import FFI
+
+from opendbc.car.structs import CarParams
+
+libpanda_dir = os.path.dirname(os.path.abspath(__file__))
+libpanda_bench_fn = os.path.join(libpanda_dir, "libpanda_bench.so")
+
+ffi = FFI()
+ffi.cdef("""
+typedef struct {
+  uint64_t ns;
+  uint64_t frames;
+  uint64_t bytes;
+} bench_result_t;
+
+int set_safety_hooks(uint16_t mode, uint16_t param);
+
+uint32_t bench_setup(uint32_t n, uint32_t mix, uint32_t seed);
+bench_result_t bench_push_pop(uint32_t iters);
+bench_result_t bench_comms_write(uint32_t chunk, uint32_t iters);
+bench_result_t bench_comms_read(uint32_t chunk, uint32_t iters);
+bench_result_t bench_safety_rx(uint32_t iters);
+bench_result_t bench_safety_tx(uint32_t iters);
+""")
+lib = ffi.dlopen(libpanda_bench_fn)
+
+FRAMES = 1200
+SEED = 0x1234
+MIXES = {"classic": 0, "fd": 1, "mixed": 2}
+CHUNKS = {"usb": 64, "spi": 4096}
+SAFETY_MODES = {
+  "allOutput": CarParams.SafetyModel.allOutput,
+  "toyota": CarParams.SafetyModel.toyota,
+  "hondaBosch": CarParams.SafetyModel.hondaBosch,
+  "hyundaiCanfd": CarParams.SafetyModel.hyundaiCanfd,
+  "ford": CarParams.SafetyModel.ford,
+}
+
+
+def result(r) -> dict:
+  ns = max(r.ns, 1)
+  return {
+    "frames_per_s": r.frames * 1e9 / ns,
+    "ns_per_frame": ns / max(r.frames, 1),
+    "mb_per_s": r.bytes * 1e3 / ns,
+  }
+
+
+def run(iters: int) -> dict[str, dict]:
+  results = {}
+  for mix_name, mix in MIXES.items():
+    # comms and queues with the safety hooks out of the way
+    assert lib.set_safety_hooks(CarParams.SafetyModel.allOutput, 0) == 0
+    lib.bench_setup(FRAMES, mix, SEED)
+    results[f"push_pop/{mix_name}"] = result(lib.bench_push_pop(iters))
+    for chunk_name, chunk in CHUNKS.items():
+      results[f"comms_write/{chunk_name}/{mix_name}"] = result(lib.bench_comms_write(chunk, iters))
+      results[f"comms_read/{chunk_name}/{mix_name}"] = result(lib.bench_comms_read(chunk, iters))
+
+    for mode_name, mode in SAFETY_MODES.items():
+      assert lib.set_safety_hooks(mode, 0) == 0
+      results[f"safety_rx/{mode_name}/{mix_name}"] = result(lib.bench_safety_rx(iters))
+      results[f"safety_tx/{mode_name}/{mix_name}"] = result(lib.bench_safety_tx(iters))
+  return results
+
+
+def compare(results: dict, baseline: dict, threshold: float) -> list[str]:
+  regressions = []
+  for name, r in results.items():
+    if name in baseline:
+      ratio = r["ns_per_frame"] / baseline[name]["ns_per_frame"]
+      if ratio > (1 + threshold):
+        regressions.append(f"{name}: {baseline[name]['ns_per_frame']:.1f} -> {r['ns_per_frame']:.1f} ns/frame ({(ratio - 1) * 100:+.0f}%)")
+  return regressions
+
+
+if __name__ == "__main__":
+  parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+  parser.add_argument("--iters", type=int, default=200, help="passes over the frame set per benchmark")
+  parser.add_argument("--json", action="store_true", help="print results as JSON")
+  parser.add_argument("--baseline", help="JSON results to compare against")
+  parser.add_argument("--threshold", type=float, default=0.15, help="allowed ns/frame regression vs. the baseline")
+  args = parser.parse_args()
+
+  results = run(args.iters)
+
+  if args.json:
+    print(json.dumps(results, indent=2))
+  else:
+    print(f"{'benchmark':<36}{'frames/s':>14}{'ns/frame':>12}{'MB/s':>10}")
+    for name, r in results.items():
+      print(f"{name:<36}{r['frames_per_s']:>14.0f}{r['ns_per_frame']:>12.1f}{r['mb_per_s']:>10.1f}")
+
+  if args.baseline is not None:
+    with open(args.baseline) as f:
+      regressions = compare(results, json.load(f), args.threshold)
+    for r in regressions:
+      print("REGRESSION", r, file=sys.stderr)
+    sys.exit(1 if len(regressions) else 0)
@@ -0,0 +1,574 @@
+// Deterministic FDCAN simulator: the real llfdcan.h and fdcan.h run against simulated cores
+// (board/fake_fdcan.h), their message RAM and a bus per core, driven by fdcan_sim.py.
+//
+// Time is virtual and advances in 1us steps. The driver runs in zero time, only how long the
+// CAN interrupts can be held off is modeled. Other nodes put frames on the bus at a given load,
+// arbitration goes to the lowest ID, and the host reads and writes through can_comms.h like
+// the USB/SPI handlers do. Every frame carries a tag in its first data bytes, so it can be
+// followed through the whole pipeline for the loss and latency stats.
+#include <sys/mman.h>
+
+#include "fake_stm.h"
+#include "fake_fdcan.h"
+#include "config.h"
+#include "can.h"
+
+#define LED_BLUE 2U
+
+typedef struct harness_configuration harness_configuration;
+void refresh_can_tx_slots_available(void);
+void can_tx_comms_resume_usb(void) { };
+void can_tx_comms_resume_spi(void) { };
+void led_set(uint8_t color, bool enabled) { UNUSED(color); UNUSED(enabled); }
+void boot_profile_rx(void) { }
+
+#include "health.h"
+#include "sys/faults.h"
+#include "libc.h"
+#include "boards/board_declarations.h"
+#include "opendbc/safety/safety.h"
+#include "main_definitions.h"
+#include "drivers/can_common.h"
+
+interrupt interrupts[NUM_INTERRUPTS];
+static bool irq_enabled[NUM_INTERRUPTS];
+
+void NVIC_EnableIRQ(IRQn_Type irq) { irq_enabled[irq] = true; }
+void NVIC_DisableIRQ(IRQn_Type irq) { irq_enabled[irq] = false; }
+void NVIC_SetPendingIRQ(IRQn_Type irq);
+
+#include "stm32h7/llfdcan.h"
+#include "drivers/fdcan.h"
+#include "comms_definitions.h"
+#include "can_comms.h"
+
+#define SIM_RAM_PAGE 0x4000A000UL
+#define SIM_RAM_LEN 0x4000UL
+#define SIM_NO_ACK 0xFFFFFFFFU
+#define SIM_TAGS 0x10000U         // frames in flight, tag timestamps are kept in a ring
+#define SIM_KIND_RX 0U            // put on the bus by another node
+#define SIM_KIND_TX 1U            // sent by the host
+#define SIM_HOST_BUF 0x4000U
+#define SIM_DRAIN_US 1000000U     // after the traffic stops, how long the pipeline gets to drain
+#define SIM_TICK_US 125000U       // 8Hz, like TICK_TIMER
+
+typedef struct {
+  uint32_t duration_us;
+  uint32_t seed;
+  uint32_t rx_load_pct[PANDA_CAN_CNT];  // frames from other nodes, % of the bus' capacity
+  uint32_t tx_rate_hz[PANDA_CAN_CNT];   // frames the host sends on each bus
+  int32_t fwd_bus[PANDA_CAN_CNT];       // bus_config forwarding, -1 for none
+  uint32_t can_speed;                   // kbps * 10, like bus_config
+  uint32_t can_data_speed;
+  uint32_t dlc;                         // of all frames, CAN FD with BRS above 8
+  uint32_t irq_latency_us;              // the CAN interrupts are serviced every this many us
+  uint32_t host_poll_us;                // the host reads and writes every this many us
+  uint32_t host_chunk;                  // in transfers of up to this many bytes
+} fdcan_sim_config_t;
+
+typedef struct {
+  uint32_t cnt;
+  uint64_t sum_us;
+  uint32_t max_us;
+} fdcan_sim_latency_t;
+
+typedef struct {
+  uint32_t rx_cnt;           // frames other nodes put on the bus
+  uint32_t rx_lost_cnt;      // overwritten in RX FIFO 0 before the driver got to them
+  uint32_t rx_host_cnt;      // received frames the host read back
+  uint32_t tx_cnt;           // frames the host sent for this bus
+  uint32_t tx_sent_cnt;      // host frames the core put on the bus
+  uint32_t tx_lost_cnt;      // host frames that never made it onto the bus
+  uint32_t fwd_cnt;          // forwarded frames the core put on the bus
+  uint32_t busy_pct;         // bus load, all nodes
+  uint32_t drv_rx_cnt;       // can_health counters, as seen by the driver
+  uint32_t drv_rx_lost_cnt;
+  uint32_t drv_fwd_cnt;
+  fdcan_sim_latency_t rx_latency;   // end of frame on the bus -> read by the host
+  fdcan_sim_latency_t tx_latency;   // written by the host -> end of frame on the bus
+  fdcan_sim_latency_t fwd_latency;  // end of frame on the source bus -> on this bus
+} fdcan_sim_stats_t;
+
+typedef struct {
+  uint32_t header[2];
+  uint32_t data_word[CANPACKET_DATA_SIZE_MAX / 4U];
+} sim_frame_t;
+
+typedef struct {
+  // RX FIFO 0
+  uint32_t rx_put;
+  uint32_t rx_get;
+  uint32_t rx_fill;
+  // the TX FIFO element
+  bool tx_pending;
+  sim_frame_t tx_frame;
+  // other nodes
+  uint64_t next_rx_ns;
+  uint32_t rx_backlog;
+  bool ext_valid;
+  sim_frame_t ext_frame;
+  // bus
+  bool busy;
+  bool busy_tx;
+  uint64_t busy_until_ns;
+  uint64_t busy_ns;
+  bool irq_pending[2];
+  uint32_t init_cnt;
+  uint64_t next_host_tx_ns;
+} sim_core_t;
+
+static fdcan_sim_config_t cfg;
+static fdcan_sim_stats_t *stats;
+static sim_core_t cores[PANDA_CAN_CNT];
+static uint64_t now_ns = 0U;
+static uint32_t rng = 1U;
+static uint32_t tag_seq = 0U;
+static uint64_t tag_ts[SIM_TAGS];
+static bool ram_mapped = false;
+
+static uint8_t host_tx_buf[SIM_HOST_BUF];
+static uint32_t host_tx_len = 0U;
+static uint8_t host_rx_buf[SIM_HOST_BUF + sizeof(CANPacket_t)];
+static uint32_t host_rx_len = 0U;
+
+// drops the first n bytes of a buffer
+static void sim_consume(uint8_t *buf, uint32_t *len, uint32_t n) {
+  for (uint32_t i = n; i < *len; i++) {
+    buf[i - n] = buf[i];
+  }
+  *len -= n;
+}
+
+static uint32_t xorshift(void) {
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return rng;
+}
+
+// the driver does its address math in 32 bit, so the message RAM has to be where it is on the H7
+static bool sim_map_ram(void) {
+  if (!ram_mapped) {
+    void *ram = mmap((void *)SIM_RAM_PAGE, SIM_RAM_LEN, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+    ram_mapped = (ram == (void *)SIM_RAM_PAGE);
+    if (!ram_mapped) {
+      print("fdcan_sim: can't map the message RAM\n");
+    }
+  }
+  return ram_mapped;
+}
+
+static volatile uint32_t *sim_rx_element(uint8_t can_number, uint32_t idx) {
+  return (volatile uint32_t *)(FDCAN_START_ADDRESS + (can_number * FDCAN_OFFSET) + (idx * FDCAN_RX_FIFO_0_EL_SIZE));
+}
+
+static volatile uint32_t *sim_tx_element(uint8_t can_number, uint32_t idx) {
+  return (volatile uint32_t *)(FDCAN_START_ADDRESS + (can_number * FDCAN_OFFSET) + (FDCAN_RX_FIFO_0_EL_CNT * FDCAN_RX_FIFO_0_EL_SIZE) + (idx * FDCAN_TX_FIFO_EL_SIZE));
+}
+
+static uint32_t sim_frame_id(const sim_frame_t *f) {
+  return ((f->header[0] >> 30) & 0x1U) ? (f->header[0] & 0x1FFFFFFFU) : ((f->header[0] >> 18) & 0x7FFU);
+}
+
+// bits on the wire incl. stuffing, nominal and data phase
+static uint64_t sim_frame_time_ns(uint8_t can_number, const sim_frame_t *f) {
+  bool ext = ((f->header[0] >> 30) & 0x1U) != 0U;
+  bool fd = ((f->header[1] >> 21) & 0x1U) != 0U;
+  bool brs = ((f->header[1] >> 20) & 0x1U) != 0U;
+  uint32_t len = dlc_to_len[(f->header[1] >> 16) & 0xFU];
+
+  uint64_t nominal_bit_ns = 10000000U / bus_config[can_number].can_speed;
+  uint64_t data_bit_ns = (fd && brs) ? (10000000U / bus_config[can_number].can_data_speed) : nominal_bit_ns;
+
+  uint32_t nominal_bits;
+  uint32_t data_bits;
+  if (fd) {
+    // arbitration plus ACK, EOF and IFS / ESI, DLC, payload and CRC
+    nominal_bits = (ext ? 37U : 17U) + 13U;
+    data_bits = 5U + (len * 8U) + ((len <= 16U) ? 22U : 26U);
+  } else {
+    nominal_bits = (ext ? 67U : 47U) + (len * 8U);
+    data_bits = 0U;
+  }
+  return ((((nominal_bits * nominal_bit_ns) + (data_bits * data_bit_ns)) * 6U) / 5U);
+}
+
+static void sim_latency(fdcan_sim_latency_t *l, uint32_t tag) {
+  uint32_t us = (uint32_t)((now_ns - tag_ts[tag % SIM_TAGS]) / 1000U);
+  l->cnt += 1U;
+  l->sum_us += us;
+  l->max_us = MAX(l->max_us, us);
+}
+
+// writes the status registers from the core state
+static void sim_status(uint8_t can_number) {
+  sim_core_t *core = &cores[can_number];
+  FDCAN_GlobalTypeDef *FDCANx = cans[can_number];
+
+  FDCANx->RXF0S_REG[0] = core->rx_fill | (core->rx_get << FDCAN_RXF0S_F0GI_Pos) | (core->rx_put << FDCAN_RXF0S_F0PI_Pos) |
+                         ((core->rx_fill == FDCAN_RX_FIFO_0_EL_CNT) ? FDCAN_RXF0S_F0F : 0U);
+  FDCANx->TXFQS_REG[0] = core->tx_pending ? FDCAN_TXFQS_TFQF : (FDCAN_TX_FIFO_EL_CNT << FDCAN_TXFQS_TFFL_Pos);
+}
+
+// latches the interrupt lines for the flags in IR
+static void sim_raise(uint8_t can_number) {
+  FDCAN_GlobalTypeDef *FDCANx = cans[can_number];
+  uint32_t active = FDCANx->IR & FDCANx->IE;
+
+  if (((active & ~FDCANx->ILS) != 0U) && ((FDCANx->ILE & FDCAN_ILE_EINT0) != 0U)) {
+    cores[can_number].irq_pending[0] = true;
+  }
+  if (((active & FDCANx->ILS) != 0U) && ((FDCANx->ILE & FDCAN_ILE_EINT1) != 0U)) {
+    cores[can_number].irq_pending[1] = true;
+  }
+}
+
+uint32_t fdcan_sim_sync(void) {
+  for (uint8_t i = 0U; i < PANDA_CAN_CNT; i++) {
+    sim_core_t *core = &cores[i];
+    FDCAN_GlobalTypeDef *FDCANx = cans[i];
+
+    // a core reset takes whatever is in the core with it
+    if (can_init_stats[i].cnt != core->init_cnt) {
+      core->init_cnt = can_init_stats[i].cnt;
+      core->tx_pending = false;
+      core->rx_put = 0U;
+      core->rx_get = 0U;
+      core->rx_fill = 0U;
+      FDCANx->RXF0A = SIM_NO_ACK;
+    }
+
+    // acknowledging an element frees it and everything before it
+    if (FDCANx->RXF0A != SIM_NO_ACK) {
+      uint32_t get = (FDCANx->RXF0A + 1U) % FDCAN_RX_FIFO_0_EL_CNT;
+      uint32_t n = (get + FDCAN_RX_FIFO_0_EL_CNT - core->rx_get) % FDCAN_RX_FIFO_0_EL_CNT;
+      core->rx_fill -= MIN((n == 0U) ? FDCAN_RX_FIFO_0_EL_CNT : n, core->rx_fill);
+      core->rx_get = get;
+      FDCANx->RXF0A = SIM_NO_ACK;
+    }
+
+    if (FDCANx->TXBAR != 0U) {
+      uint32_t idx = (uint32_t)__builtin_ctz(FDCANx->TXBAR);
+      volatile uint32_t *el = sim_tx_element(i, idx);
+      for (uint32_t j = 0U; j < (FDCAN_TX_FIFO_EL_SIZE / 4U); j++) {
+        ((uint32_t *)&core->tx_frame)[j] = el[j];
+      }
+      core->tx_pending = true;
+      FDCANx->TXBRP = FDCANx->TXBAR;
+      FDCANx->TXBAR = 0U;
+    }
+    sim_status(i);
+  }
+  return 0U;
+}
+
+static void sim_frame_make(sim_frame_t *f, uint32_t kind) {
+  bool fd = cfg.dlc > 8U;
+  uint32_t tag = tag_seq;
+  tag_seq += 1U;
+
+  f->header[0] = (xorshift() & 0x7FFU) << 18;
+  f->header[1] = (cfg.dlc << 16) | (fd ? ((1UL << 21) | (1UL << 20)) : 0U);
+  f->data_word[0] = tag;
+  f->data_word[1] = kind | (xorshift() << 8);
+  for (uint32_t i = 2U; i < (CANPACKET_DATA_SIZE_MAX / 4U); i++) {
+    f->data_word[i] = xorshift();
+  }
+}
+
+static uint64_t sim_rx_interval_ns(uint8_t can_number) {
+  sim_frame_t f;
+  f.header[0] = 0U;
+  f.header[1] = (cfg.dlc << 16) | ((cfg.dlc > 8U) ? ((1UL << 21) | (1UL << 20)) : 0U);
+  uint64_t base = (sim_frame_time_ns(can_number, &f) * 100U) / cfg.rx_load_pct[can_number];
+  return (base * (75U + (xorshift() % 51U))) / 100U;
+}
+
+// a frame from another node is complete, it goes into RX FIFO 0
+static void sim_rx_done(uint8_t can_number) {
+  sim_core_t *core = &cores[can_number];
+  FDCAN_GlobalTypeDef *FDCANx = cans[can_number];
+
+  core->rx_backlog -= 1U;
+  core->ext_valid = false;
+  stats[can_number].rx_cnt += 1U;
+  tag_ts[core->ext_frame.data_word[0] % SIM_TAGS] = now_ns;
+
+  if (core->rx_fill == FDCAN_RX_FIFO_0_EL_CNT) {
+    // overwrite mode, the oldest element goes
+    core->rx_get = (core->rx_get + 1U) % FDCAN_RX_FIFO_0_EL_CNT;
+    stats[can_number].rx_lost_cnt += 1U;
+    FDCANx->IR |= FDCAN_IR_RF0L;
+  } else {
+    core->rx_fill += 1U;
+  }
+  volatile uint32_t *el = sim_rx_element(can_number, core->rx_put);
+  for (uint32_t j = 0U; j < (FDCAN_RX_FIFO_0_EL_SIZE / 4U); j++) {
+    el[j] = ((uint32_t *)&core->ext_frame)[j];
+  }
+  core->rx_put = (core->rx_put + 1U) % FDCAN_RX_FIFO_0_EL_CNT;
+
+  FDCANx->IR |= FDCAN_IR_RF0N;
+  sim_raise(can_number);
+  sim_status(can_number);
+}
+
+// the TX FIFO element is out, host frames and forwarded ones are told apart by their tag
+static void sim_tx_done(uint8_t can_number, bool on_bus) {
+  sim_core_t *core = &cores[can_number];
+  FDCAN_GlobalTypeDef *FDCANx = cans[can_number];
+
+  core->tx_pending = false;
+  FDCANx->TXBRP = 0U;
+  if (on_bus) {
+    if ((core->tx_frame.data_word[1] & 0xFFU) == SIM_KIND_TX) {
+      stats[can_number].tx_sent_cnt += 1U;
+      sim_latency(&stats[can_number].tx_latency, core->tx_frame.data_word[0]);
+    } else {
+      stats[can_number].fwd_cnt += 1U;
+      sim_latency(&stats[can_number].fwd_latency, core->tx_frame.data_word[0]);
+    }
+  }
+
+  FDCANx->IR |= FDCAN_IR_TFE;
+  sim_raise(can_number);
+  sim_status(can_number);
+}
+
+static void sim_bus_step(uint8_t can_number, bool traffic) {
+  sim_core_t *core = &cores[can_number];
+
+  // other nodes queue up their frames until they win the bus
+  while (traffic && (cfg.rx_load_pct[can_number] != 0U) && (now_ns >= core->next_rx_ns)) {
+    core->rx_backlog += 1U;
+    core->next_rx_ns += sim_rx_interval_ns(can_number);
+  }
+  if ((core->rx_backlog > 0U) && !core->ext_valid) {
+    sim_frame_make(&core->ext_frame, SIM_KIND_RX);
+    core->ext_valid = true;
+  }
+
+  if (core->busy && (now_ns >= core->busy_until_ns)) {
+    core->busy = false;
+    if (core->busy_tx) {
+      sim_tx_done(can_number, true);
+    } else {
+      sim_rx_done(can_number);
+    }
+  }
+
+  // bus monitoring mode, frames are only looped back internally
+  if (core->tx_pending && ((cans[can_number]->CCCR & FDCAN_CCCR_MON) != 0U)) {
+    sim_tx_done(can_number, false);
+  }
+
+  if (!core->busy) {
+    const sim_frame_t *f = NULL;
+    if (core->tx_pending && (!core->ext_valid || (sim_frame_id(&core->tx_frame) <= sim_frame_id(&core->ext_frame)))) {
+      f = &core->tx_frame;
+      core->busy_tx = true;
+    } else if (core->ext_valid) {
+      f = &core->ext_frame;
+      core->busy_tx = false;
+    } else {
+    }
+
+    if (f != NULL) {
+      uint64_t t = sim_frame_time_ns(can_number, f);
+      core->busy = true;
+      core->busy_until_ns = now_ns + t;
+      core->busy_ns += t;
+    }
+  }
+}
+
+void NVIC_SetPendingIRQ(IRQn_Type irq) {
+  for (uint8_t i = 0U; i < PANDA_CAN_CNT; i++) {
+    if (irq == ((i == 0U) ? FDCAN1_IT1_IRQn : ((i == 1U) ? FDCAN2_IT1_IRQn : FDCAN3_IT1_IRQn))) {
+      cores[i].irq_pending[1] = true;
+    }
+  }
+}
+
+// IT0 and IT1 of all cores, in NVIC priority order
+static void sim_irqs(void) {
+  static const struct {
+    IRQn_Type irq;
+    uint8_t can_number;
+    uint8_t line;
+  } lines[] = {
+    {FDCAN1_IT0_IRQn, 0U, 0U}, {FDCAN2_IT0_IRQn, 1U, 0U}, {FDCAN1_IT1_IRQn, 0U, 1U},
+    {FDCAN2_IT1_IRQn, 1U, 1U}, {FDCAN3_IT0_IRQn, 2U, 0U}, {FDCAN3_IT1_IRQn, 2U, 1U},
+  };
+
+  for (uint32_t i = 0U; i < (sizeof(lines) / sizeof(lines[0])); i++) {
+    sim_core_t *core = &cores[lines[i].can_number];
+    if (core->irq_pending[lines[i].line] && irq_enabled[lines[i].irq] && (interrupts[lines[i].irq].handler != NULL)) {
+      core->irq_pending[lines[i].line] = false;
+      interrupts[lines[i].irq].call_counter += 1U;
+      interrupts[lines[i].irq].handler();
+      // the handlers clear their flags with IR |= x, which on the H7 clears every flag that was set
+      cans[lines[i].can_number]->IR = 0U;
+      (void)fdcan_sim_sync();
+    }
+  }
+}
+
+static void sim_host_rx(const CANPacket_t *pkt) {
+  uint32_t tag = pkt->data[0] | (pkt->data[1] << 8) | (pkt->data[2] << 16) | ((uint32_t)pkt->data[3] << 24);
+  if ((pkt->returned == 0U) && (pkt->rejected == 0U) && (pkt->data[4] == SIM_KIND_RX) && (pkt->bus < PANDA_CAN_CNT)) {
+    stats[pkt->bus].rx_host_cnt += 1U;
+    sim_latency(&stats[pkt->bus].rx_latency, tag);
+  }
+}
+
+static void sim_host(bool traffic) {
+  // host -> panda, the host stops writing when the panda has no room (USB NAKs)
+  for (uint8_t i = 0U; traffic && (i < PANDA_CAN_CNT); i++) {
+    sim_core_t *core = &cores[i];
+    while ((cfg.tx_rate_hz[i] != 0U) && (now_ns >= core->next_host_tx_ns)) {
+      core->next_host_tx_ns += 1000000000U / cfg.tx_rate_hz[i];
+      stats[i].tx_cnt += 1U;
+
+      CANPacket_t pkt = {0};
+      sim_frame_t f;
+      sim_frame_make(&f, SIM_KIND_TX);
+      tag_ts[f.data_word[0] % SIM_TAGS] = now_ns;
+      pkt.fd = (cfg.dlc > 8U) ? 1U : 0U;
+      pkt.bus = i;
+      pkt.data_len_code = cfg.dlc;
+      pkt.addr = sim_frame_id(&f);
+      for (uint32_t j = 0U; j < dlc_to_len[cfg.dlc]; j++) {
+        pkt.data[j] = (f.data_word[j / 4U] >> ((j % 4U) * 8U)) & 0xFFU;
+      }
+      can_set_checksum(&pkt);
+
+      uint32_t len = CANPACKET_HEAD_SIZE + dlc_to_len[cfg.dlc];
+      if ((host_tx_len + len) <= SIM_HOST_BUF) {
+        (void)memcpy(&host_tx_buf[host_tx_len], (uint8_t *)&pkt, len);
+        host_tx_len += len;
+      }
+    }
+  }
+
+  uint32_t pos = 0U;
+  while ((pos < host_tx_len) && can_tx_check_min_slots_free(MAX_CAN_MSGS_PER_USB_BULK_TRANSFER)) {
+    uint32_t n = MIN(cfg.host_chunk, host_tx_len - pos);
+    comms_can_write(&host_tx_buf[pos], n);
+    pos += n;
+  }
+  sim_consume(host_tx_buf, &host_tx_len, pos);
+
+  // panda -> host
+  int n;
+  while ((n = comms_can_read(&host_rx_buf[host_rx_len], MIN(cfg.host_chunk, SIM_HOST_BUF))) > 0) {
+    host_rx_len += (uint32_t)n;
+    uint32_t off = 0U;
+    while (off < host_rx_len) {
+      uint32_t len = CANPACKET_HEAD_SIZE + dlc_to_len[host_rx_buf[off] >> 4U];
+      if ((off + len) > host_rx_len) {
+        break;
+      }
+      CANPacket_t pkt = {0};
+      (void)memcpy((uint8_t *)&pkt, &host_rx_buf[off], len);
+      sim_host_rx(&pkt);
+      off += len;
+    }
+    sim_consume(host_rx_buf, &host_rx_len, off);
+  }
+}
+
+static bool sim_idle(void) {
+  bool idle = (host_tx_len == 0U) && (can_rx_q.w_ptr == can_rx_q.r_ptr);
+  for (uint8_t i = 0U; i < PANDA_CAN_CNT; i++) {
+    idle = idle && !cores[i].busy && !cores[i].tx_pending && (cores[i].rx_backlog == 0U) && (cores[i].rx_fill == 0U) &&
+           (can_queues[i]->w_ptr == can_queues[i]->r_ptr);
+  }
+  return idle;
+}
+
+// runs one scenario, fills in stats for each bus and returns the simulated time in us
+uint32_t fdcan_sim_run(const fdcan_sim_config_t *config, fdcan_sim_stats_t *out) {
+  uint32_t now_us = 0U;
+
+  if (sim_map_ram()) {
+    cfg = *config;
+    cfg.irq_latency_us = MAX(cfg.irq_latency_us, 1U);
+    cfg.host_poll_us = MAX(cfg.host_poll_us, 1U);
+    cfg.host_chunk = CLAMP(cfg.host_chunk, 1U, SIM_HOST_BUF);
+    cfg.dlc = MIN(cfg.dlc, 15U);
+    stats = out;
+    (void)memset(stats, 0, PANDA_CAN_CNT * sizeof(fdcan_sim_stats_t));
+    (void)memset(cores, 0, sizeof(cores));
+    (void)memset(fdcan_sim_regs, 0, sizeof(fdcan_sim_regs));
+    (void)memset(can_health, 0, sizeof(can_health));
+    rng = (cfg.seed != 0U) ? cfg.seed : 1U;
+    tag_seq = 0U;
+    now_ns = 0U;
+    host_tx_len = 0U;
+    host_rx_len = 0U;
+    MICROSECOND_TIMER->CNT = 0U;
+    rx_buffer_overflow = 0U;
+    tx_buffer_overflow = 0U;
+    can_clear(&can_rx_q);
+    comms_can_reset();
+
+    can_silent = false;
+    can_loopback = false;
+    for (uint8_t i = 0U; i < PANDA_CAN_CNT; i++) {
+      cans[i]->RXF0A = SIM_NO_ACK;
+      bus_config[i].forwarding_bus = cfg.fwd_bus[i];
+      bus_config[i].can_speed = cfg.can_speed;
+      bus_config[i].can_data_speed = cfg.can_data_speed;
+      bus_config[i].brs_enabled = false;
+    }
+    can_init_all();
+    for (uint8_t i = 0U; i < PANDA_CAN_CNT; i++) {
+      cores[i].init_cnt = can_init_stats[i].cnt;
+      if (cfg.rx_load_pct[i] != 0U) {
+        cores[i].next_rx_ns = sim_rx_interval_ns(i);
+      }
+    }
+    (void)fdcan_sim_sync();
+
+    uint64_t end_ns = (uint64_t)cfg.duration_us * 1000U;
+    uint64_t drain_ns = end_ns + ((uint64_t)SIM_DRAIN_US * 1000U);
+    for (now_us = 0U; ; now_us++) {
+      now_ns = (uint64_t)now_us * 1000U;
+      MICROSECOND_TIMER->CNT = now_us;
+
+      bool traffic = now_ns < end_ns;
+      if (!traffic && (sim_idle() || (now_ns >= drain_ns))) {
+        break;
+      }
+
+      for (uint8_t i = 0U; i < PANDA_CAN_CNT; i++) {
+        sim_bus_step(i, traffic);
+      }
+      if ((now_us % cfg.irq_latency_us) == 0U) {
+        sim_irqs();
+      }
+      if ((now_us % cfg.host_poll_us) == 0U) {
+        sim_host(traffic);
+        (void)fdcan_sim_sync();
+      }
+      if (((CAN_INIT_TIMER->DIER & TIM_DIER_CC1IE) != 0U) && (CAN_INIT_TIMER->CCR1 == now_us) && irq_enabled[CAN_INIT_TIMER_IRQ]) {
+        interrupts[CAN_INIT_TIMER_IRQ].handler();
+        (void)fdcan_sim_sync();
+      }
+      if ((now_us % SIM_TICK_US) == 0U) {
+        can_init_tick();
+        (void)fdcan_sim_sync();
+      }
+    }
+
+    for (uint8_t i = 0U; i < PANDA_CAN_CNT; i++) {
+      stats[i].tx_lost_cnt = stats[i].tx_cnt - stats[i].tx_sent_cnt;
+      stats[i].busy_pct = (uint32_t)((cores[i].busy_ns * 100U) / MAX(now_ns, 1U));
+      stats[i].drv_rx_cnt = can_health[i].total_rx_cnt;
+      stats[i].drv_rx_lost_cnt = can_health[i].total_rx_lost_cnt;
+      stats[i].drv_fwd_cnt = can_health[i].total_fwd_cnt;
+    }
+  }
+  return now_us;
+}
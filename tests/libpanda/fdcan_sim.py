@@ -0,0 +1,151 @@
+#!/usr/bin/env python3
+"""
+End-to-end runs of the CAN path against simulated FDCAN cores: the real fdcan.h RX/TX
+handlers, the CAN queues and can_comms.h, at a given bus load. Time is virtual, so runs
+are deterministic for a seed. The simulator is in fdcan_sim.c.
+
+  ./fdcan_sim.py --load 80 --tx-rate 1000          # table, one row per bus
+  ./fdcan_sim.py --load 90 --irq-latency 20000     # interrupts held off for 20ms at a time
+  ./fdcan_sim.py --fwd 2,-1,0 --mode toyota --json
+"""
+import os
+import json
+import argparse
+from cffi import FFI
+
+from opendbc.car.structs import CarParams
+
+libpanda_dir = os.path.dirname(os.path.abspath(__file__))
+libfdcan_sim_fn = os.path.join(libpanda_dir, "libfdcan_sim.so")
+
+ffi = FFI()
+ffi.cdef("""
+typedef struct {
+  uint32_t duration_us;
+  uint32_t seed;
+  uint32_t rx_load_pct[3];
+  uint32_t tx_rate_hz[3];
+  int32_t fwd_bus[3];
+  uint32_t can_speed;
+  uint32_t can_data_speed;
+  uint32_t dlc;
+  uint32_t irq_latency_us;
+  uint32_t host_poll_us;
+  uint32_t host_chunk;
+} fdcan_sim_config_t;
+
+typedef struct {
+  uint32_t cnt;
+  uint64_t sum_us;
+  uint32_t max_us;
+} fdcan_sim_latency_t;
+
+typedef struct {
+  uint32_t rx_cnt;
+  uint32_t rx_lost_cnt;
+  uint32_t rx_host_cnt;
+  uint32_t tx_cnt;
+  uint32_t tx_sent_cnt;
+  uint32_t tx_lost_cnt;
+  uint32_t fwd_cnt;
+  uint32_t busy_pct;
+  uint32_t drv_rx_cnt;
+  uint32_t drv_rx_lost_cnt;
+  uint32_t drv_fwd_cnt;
+  fdcan_sim_latency_t rx_latency;
+  fdcan_sim_latency_t tx_latency;
+  fdcan_sim_latency_t fwd_latency;
+} fdcan_sim_stats_t;
+
+int set_safety_hooks(uint16_t mode, uint16_t param);
+uint32_t fdcan_sim_run(const fdcan_sim_config_t *config, fdcan_sim_stats_t *out);
+
+extern uint32_t rx_buffer_overflow;
+extern uint32_t tx_buffer_overflow;
+""")
+lib = ffi.dlopen(libfdcan_sim_fn)
+
+BUS_CNT = 3
+COUNTERS = ("rx_cnt", "rx_lost_cnt", "rx_host_cnt", "tx_cnt", "tx_sent_cnt", "tx_lost_cnt", "fwd_cnt", "busy_pct",
+            "drv_rx_cnt", "drv_rx_lost_cnt", "drv_fwd_cnt")
+LATENCIES = ("rx_latency", "tx_latency", "fwd_latency")
+
+
+def per_bus(v) -> list:
+  return list(v) if isinstance(v, (list, tuple)) else [v] * BUS_CNT
+
+
+def run(duration_us=1_000_000, seed=0x1234, load=30, tx_rate=0, fwd=-1, can_speed=5000, can_data_speed=20000, dlc=8,
+        irq_latency_us=1, host_poll_us=1000, host_chunk=0x4000, mode=CarParams.SafetyModel.allOutput) -> dict:
+  """load, tx_rate and fwd are either one value for all busses or one per bus"""
+  assert lib.set_safety_hooks(mode, 0) == 0
+
+  config = ffi.new("fdcan_sim_config_t *", {
+    "duration_us": duration_us,
+    "seed": seed,
+    "rx_load_pct": per_bus(load),
+    "tx_rate_hz": per_bus(tx_rate),
+    "fwd_bus": per_bus(fwd),
+    "can_speed": can_speed,
+    "can_data_speed": can_data_speed,
+    "dlc": dlc,
+    "irq_latency_us": irq_latency_us,
+    "host_poll_us": host_poll_us,
+    "host_chunk": host_chunk,
+  })
+  stats = ffi.new("fdcan_sim_stats_t[]", BUS_CNT)
+  sim_us = lib.fdcan_sim_run(config, stats)
+  assert sim_us > 0, "simulator failed to start"
+
+  busses = []
+  for s in stats:
+    bus = {c: getattr(s, c) for c in COUNTERS}
+    for l in LATENCIES:
+      lat = getattr(s, l)
+      bus[l] = {"avg_us": lat.sum_us / max(lat.cnt, 1), "max_us": lat.max_us}
+    busses.append(bus)
+  return {
+    "sim_us": sim_us,
+    "rx_buffer_overflow": lib.rx_buffer_overflow,
+    "tx_buffer_overflow": lib.tx_buffer_overflow,
+    "busses": busses,
+  }
+
+
+def print_table(r: dict):
+  print(f"{'bus':<4}{'load%':>6}{'rx':>8}{'rx lost':>9}{'to host':>9}{'tx':>8}{'tx lost':>9}{'fwd':>8}"
+        f"{'rx lat avg/max us':>20}{'tx lat avg/max us':>20}{'fwd lat avg/max us':>20}")
+  for i, b in enumerate(r["busses"]):
+    lat = [f"{b[l]['avg_us']:.0f}/{b[l]['max_us']}" for l in LATENCIES]
+    print(f"{i:<4}{b['busy_pct']:>6}{b['rx_cnt']:>8}{b['rx_lost_cnt']:>9}{b['rx_host_cnt']:>9}{b['tx_cnt']:>8}{b['tx_lost_cnt']:>9}"
+          f"{b['fwd_cnt']:>8}{lat[0]:>20}{lat[1]:>20}{lat[2]:>20}")
+  print(f"simulated {r['sim_us'] / 1e6:.3f}s, rx_buffer_overflow {r['rx_buffer_overflow']}, tx_buffer_overflow {r['tx_buffer_overflow']}")
+
+
+def int_list(s: str) -> list[int]:
+  v = [int(x) for x in s.split(",")]
+  return v if len(v) > 1 else v[0]
+
+
+if __name__ == "__main__":
+  parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+  parser.add_argument("--duration", type=float, default=1.0, help="seconds of traffic")
+  parser.add_argument("--seed", type=int, default=0x1234)
+  parser.add_argument("--load", type=int_list, default=30, help="%% bus load from other nodes, one value or per bus")
+  parser.add_argument("--tx-rate", type=int_list, default=0, help="frames/s the host sends, one value or per bus")
+  parser.add_argument("--fwd", type=int_list, default=-1, help="forward each bus to this bus, -1 for none")
+  parser.add_argument("--dlc", type=int, default=8, help="CAN FD with BRS above 8")
+  parser.add_argument("--irq-latency", type=int, default=1, help="us the CAN interrupts are held off at a time")
+  parser.add_argument("--host-poll", type=int, default=1000, help="us between host transfers")
+  parser.add_argument("--host-chunk", type=int, default=0x4000, help="bytes per host transfer")
+  parser.add_argument("--mode", default="allOutput", help="safety model")
+  parser.add_argument("--json", action="store_true", help="print results as JSON")
+  args = parser.parse_args()
+
+  r = run(duration_us=int(args.duration * 1e6), seed=args.seed, load=args.load, tx_rate=args.tx_rate, fwd=args.fwd, dlc=args.dlc,
+          irq_latency_us=args.irq_latency, host_poll_us=args.host_poll, host_chunk=args.host_chunk,
+          mode=getattr(CarParams.SafetyModel, args.mode))
+  if args.json:
+    print(json.dumps(r, indent=2))
+  else:
+    print_table(r)
@@ -0,0 +1,52 @@
+// Host build of the audio kernels in board/stm32h7/sound_dsp.h, driven by test_sound_dsp.py.
+// The M7 DSP instructions they use are modelled in C, including the APSR.GE flags sel reads.
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "board/utils.h"
+
+static uint32_t ge_flags = 0U;  // one bit per byte, like APSR.GE[3:0]
+
+uint32_t __UADD16(uint32_t op1, uint32_t op2) {
+  uint32_t lo = (op1 & 0xFFFFU) + (op2 & 0xFFFFU);
+  uint32_t hi = (op1 >> 16) + (op2 >> 16);
+  ge_flags = ((lo > 0xFFFFU) ? 0x3U : 0U) | ((hi > 0xFFFFU) ? 0xCU : 0U);
+  return (lo & 0xFFFFU) | (hi << 16);
+}
+
+uint32_t __USUB16(uint32_t op1, uint32_t op2) {
+  uint32_t lo = (op1 & 0xFFFFU) - (op2 & 0xFFFFU);
+  uint32_t hi = (op1 >> 16) - (op2 >> 16);
+  ge_flags = (((op1 & 0xFFFFU) >= (op2 & 0xFFFFU)) ? 0x3U : 0U) | (((op1 >> 16) >= (op2 >> 16)) ? 0xCU : 0U);
+  return (lo & 0xFFFFU) | (hi << 16);
+}
+
+uint32_t __SEL(uint32_t op1, uint32_t op2) {
+  uint32_t mask = 0U;
+  for (uint32_t i = 0U; i < 4U; i++) {
+    if ((ge_flags & (1UL << i)) != 0U) {
+      mask |= 0xFFUL << (8U * i);
+    }
+  }
+  return (op1 & mask) | (op2 & ~mask);
+}
+
+uint32_t __SMLAD(uint32_t op1, uint32_t op2, uint32_t op3) {
+  int32_t lo = (int32_t)(int16_t)(op1 & 0xFFFFU) * (int32_t)(int16_t)(op2 & 0xFFFFU);
+  int32_t hi = (int32_t)(int16_t)(op1 >> 16) * (int32_t)(int16_t)(op2 >> 16);
+  return (uint32_t)((int32_t)op3 + lo + hi);
+}
+
+int32_t __SSAT(int32_t val, uint32_t sat) {
+  int32_t max = (int32_t)((1UL << (sat - 1U)) - 1U);
+  return (val > max) ? max : ((val < (-max - 1)) ? (-max - 1) : val);
+}
+
+// same as cmsis_gcc.h
+#define __PKHBT(ARG1,ARG2,ARG3)          ( ((((uint32_t)(ARG1))          ) & 0x0000FFFFUL) |  \
+                                           ((((uint32_t)(ARG2)) << (ARG3)) & 0xFFFF0000UL)  )
+
+#define __PKHTB(ARG1,ARG2,ARG3)          ( ((((uint32_t)(ARG1))          ) & 0xFFFF0000UL) |  \
+                                           ((((uint32_t)(ARG2)) >> (ARG3)) & 0x0000FFFFUL)  )
+
+#include "board/stm32h7/sound_dsp.h"
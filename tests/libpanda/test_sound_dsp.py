@@ -0,0 +1,87 @@
+#!/usr/bin/env python3
+import os
+import random
+import unittest
+from cffi import FFI
+
+libpanda_dir = os.path.dirname(os.path.abspath(__file__))
+
+ffi = FFI()
+ffi.cdef("""
+uint32_t sound_convert_ref(const uint16_t *rx, uint16_t *tx, uint32_t frames, bool *playing);
+uint32_t sound_convert(const uint16_t *rx, uint16_t *tx, uint32_t frames, bool *playing);
+void mic_convert_ref(const uint32_t *rx, uint16_t *tx, uint32_t n);
+void mic_convert(const uint32_t *rx, uint16_t *tx, uint32_t n);
+uint16_t mic_convert_gain(const uint32_t *rx, uint16_t *tx, uint32_t n, uint16_t gain, uint8_t up, bool mono);
+void sound_fill(uint16_t *tx, uint16_t value, uint32_t n);
+""")
+lib = ffi.dlopen(os.path.join(libpanda_dir, "libsound_dsp.so"))
+
+SOUND_FRAMES = 500  # SOUND_RX_BUF_SIZE / 2
+MIC_SAMPLES = 512   # MIC_RX_BUF_SIZE
+
+
+class TestSoundDsp(unittest.TestCase):
+  def sound_convert(self, fn, rx):
+    tx = ffi.new("uint16_t[]", SOUND_FRAMES)
+    playing = ffi.new("bool *", False)
+    abs_sum = fn(ffi.new("uint16_t[]", rx), tx, SOUND_FRAMES, playing)
+    return abs_sum, list(tx), playing[0]
+
+  def test_sound_convert(self):
+    rng = random.Random(0x1234)
+    cases = [
+      [0] * (2 * SOUND_FRAMES),
+      [0xFFFF] * (2 * SOUND_FRAMES),
+      [rng.choice((0, 0x3FFF, 0x4000, 0x7FFF, 0x8000, 0xBFFF, 0xC000)) for _ in range(2 * SOUND_FRAMES)],
+      # right channel only, not played
+      [0 if i % 2 == 0 else rng.randrange(0x10000) for i in range(2 * SOUND_FRAMES)],
+    ]
+    cases += [[rng.randrange(0x10000) for _ in range(2 * SOUND_FRAMES)] for _ in range(50)]
+    for rx in cases:
+      self.assertEqual(self.sound_convert(lib.sound_convert, rx), self.sound_convert(lib.sound_convert_ref, rx))
+
+  def test_mic_convert(self):
+    rng = random.Random(0x1234)
+    cases = [[0] * MIC_SAMPLES, [0xFFFFFFFF] * MIC_SAMPLES]
+    cases += [[rng.randrange(0x100000000) for _ in range(MIC_SAMPLES)] for _ in range(50)]
+    for rx in cases:
+      ref = ffi.new("uint16_t[]", 2 * MIC_SAMPLES)
+      out = ffi.new("uint16_t[]", 2 * MIC_SAMPLES)
+      lib.mic_convert_ref(ffi.new("uint32_t[]", rx), ref, MIC_SAMPLES)
+      lib.mic_convert(ffi.new("uint32_t[]", rx), out, MIC_SAMPLES)
+      self.assertEqual(list(out), list(ref))
+
+  def test_mic_convert_gain(self):
+    rng = random.Random(0x1234)
+    def sat16(x):
+      return max(-0x8000, min(x, 0x7FFF))
+
+    for gain, up in ((1, 0), (128, 0), (256, 0), (300, 0), (1024, 0), (4096, 0), (256, 3), (256, 16), (4096, 8)):
+      for mono in (False, True):
+        # quiet samples too, like a low gain filter produces
+        rx = [rng.randrange(0x100000000) >> rng.choice((0, 12, 20)) for _ in range(MIC_SAMPLES)]
+        tx = ffi.new("uint16_t[]", 2 * MIC_SAMPLES)
+        peak = lib.mic_convert_gain(ffi.new("uint32_t[]", rx), tx, MIC_SAMPLES, gain, up, mono)
+
+        samples = [sat16((sat16(((s ^ 0x80000000) - 0x80000000) >> (16 - up)) * gain) >> 8) & 0xFFFF for s in rx]
+        expected = samples if mono else [s for s in samples for _ in range(2)]
+        self.assertEqual(list(tx)[:len(expected)], expected)
+        self.assertEqual(peak, max(abs(((s ^ 0x8000) - 0x8000)) for s in samples))
+
+    # unity gain stereo is mic_convert
+    rx = [rng.randrange(0x100000000) for _ in range(MIC_SAMPLES)]
+    ref = ffi.new("uint16_t[]", 2 * MIC_SAMPLES)
+    out = ffi.new("uint16_t[]", 2 * MIC_SAMPLES)
+    lib.mic_convert(ffi.new("uint32_t[]", rx), ref, MIC_SAMPLES)
+    lib.mic_convert_gain(ffi.new("uint32_t[]", rx), out, MIC_SAMPLES, 256, 0, False)
+    self.assertEqual(list(out), list(ref))
+
+  def test_sound_fill(self):
+    tx = ffi.new("uint16_t[]", SOUND_FRAMES)
+    lib.sound_fill(tx, 0x800, SOUND_FRAMES)
+    self.assertEqual(list(tx), [0x800] * SOUND_FRAMES)
+
+
+if __name__ == "__main__":
+  unittest.main()
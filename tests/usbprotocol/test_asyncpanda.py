@@ -0,0 +1,97 @@
+#!/usr/bin/env python3
+import asyncio
+import threading
+import unittest
+
+from panda import AsyncPanda, Panda
+
+
+class FakeHandle:
+  def __init__(self):
+    self.requests = []
+
+  def controlRead(self, request_type, request, value, index, length, timeout=None):
+    self.requests.append((request_type, request, value, index, length))
+    return bytes(length)
+
+  def controlWrite(self, request_type, request, value, index, data, timeout=None):
+    self.requests.append((request_type, request, value, index, data))
+
+
+class FakePanda:
+  def __init__(self):
+    self._handle = FakeHandle()
+    self.sent = []
+    self.rx = []
+    self.rx_gate = threading.Event()
+    self.rx_gate.set()
+    self.closed = False
+
+  def health(self):
+    return {"uptime": 1}
+
+  def can_send_many(self, arr, fd=False, timeout=0):
+    self.sent.extend(arr)
+
+  def can_recv(self):
+    # blocks like a CAN read waiting on the device
+    self.rx_gate.wait()
+    ret, self.rx = self.rx, []
+    return ret
+
+  def close(self):
+    self.closed = True
+
+
+class TestAsyncPanda(unittest.IsolatedAsyncioTestCase):
+  async def asyncSetUp(self):
+    self.fake = FakePanda()
+    self.p = AsyncPanda(self.fake)
+
+  async def asyncTearDown(self):
+    self.fake.rx_gate.set()
+    await self.p.close()
+
+  async def test_control(self):
+    self.assertEqual(await self.p.control_read(0xd2, 1, 2, 8), bytes(8))
+    await self.p.control_write(0xdc, 3, 4)
+    self.assertEqual(self.fake._handle.requests, [(Panda.REQUEST_IN, 0xd2, 1, 2, 8), (Panda.REQUEST_OUT, 0xdc, 3, 4, b'')])
+
+  async def test_can_send(self):
+    await self.p.can_send_many([(0x100, b"\x01", 0)])
+    await self.p.can_send(0x200, b"\x02", 1)
+    self.assertEqual(self.fake.sent, [(0x100, b"\x01", 0), [0x200, b"\x02", 1]])
+
+  async def test_can_stream(self):
+    self.fake.rx = [(0x300, b"\x03", 0), (0x301, b"\x04", 1)]
+    stream = self.p.can_stream()
+    self.assertEqual(await asyncio.wait_for(anext(stream), 1.0), [(0x300, b"\x03", 0), (0x301, b"\x04", 1)])
+
+    # empty reads are polled again until something arrives
+    loop = asyncio.get_running_loop()
+    loop.call_later(0.01, lambda: self.fake.rx.append((0x302, b"", 2)))
+    self.assertEqual(await asyncio.wait_for(anext(stream), 1.0), [(0x302, b"", 2)])
+    await stream.aclose()
+
+  async def test_health_during_can_rx(self):
+    # a CAN read stuck on the device doesn't hold up control requests
+    self.fake.rx_gate.clear()
+    rx = asyncio.ensure_future(self.p.can_recv())
+    await asyncio.sleep(0.01)
+    self.assertFalse(rx.done())
+    self.assertEqual(await asyncio.wait_for(self.p.health(), 1.0), {"uptime": 1})
+
+    self.fake.rx = [(0x400, b"", 0)]
+    self.fake.rx_gate.set()
+    self.assertEqual(await asyncio.wait_for(rx, 1.0), [(0x400, b"", 0)])
+
+  async def test_close(self):
+    await self.p.call("health")
+    await self.p.close()
+    self.assertTrue(self.fake.closed)
+    with self.assertRaises(RuntimeError):
+      await self.p.health()
+
+
+if __name__ == "__main__":
+  unittest.main()
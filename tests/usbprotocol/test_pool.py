@@ -0,0 +1,93 @@
+#!/usr/bin/env python3
+import time
+import threading
+import unittest
+
+from panda import PandaPool
+
+
+class FakePanda:
+  opened: dict = {}
+
+  def __init__(self, serial=None, cli=False):
+    self.serial = serial
+    self.sent = []
+    self.rx = []
+    self.closed = False
+    self.lock = threading.Lock()
+    FakePanda.opened[serial] = self
+
+  def get_usb_serial(self):
+    return self.serial
+
+  def can_send_many(self, msgs):
+    with self.lock:
+      self.sent.extend(msgs)
+
+  def can_recv(self):
+    with self.lock:
+      ret, self.rx = self.rx, []
+    return ret
+
+  def close(self):
+    self.closed = True
+
+
+def wait_for(cond, timeout=2.0):
+  end = time.monotonic() + timeout
+  while not cond() and time.monotonic() < end:
+    time.sleep(0.001)
+  return cond()
+
+
+class TestPandaPool(unittest.TestCase):
+  def setUp(self):
+    FakePanda.opened = {}
+
+  def test_fan_out(self):
+    serials = ["a", "b", "c"]
+    with PandaPool(serials, panda_cls=FakePanda) as pool:
+      self.assertEqual(pool.serials, serials)
+      for i, s in enumerate(serials):
+        pool.can_send_many(s, [(0x100 + i, bytes([i]), 0)])
+        with FakePanda.opened[s].lock:
+          FakePanda.opened[s].rx = [(0x200 + i, bytes([i] * 8), 1)]
+
+      for i, s in enumerate(serials):
+        self.assertTrue(wait_for(lambda s=s: len(FakePanda.opened[s].sent) == 1))
+        self.assertEqual(FakePanda.opened[s].sent, [(0x100 + i, bytes([i]), 0)])
+
+      self.assertTrue(wait_for(lambda: all(pool.stats()[s]["rx_msgs"] == 1 for s in serials)))
+      rx = pool.can_recv_all()
+      for i, s in enumerate(serials):
+        self.assertEqual(rx[s], [(0x200 + i, bytes([i] * 8), 1)])
+        self.assertEqual(pool.stats()[s]["rx_dropped"], 0)
+
+  def test_rx_drop(self):
+    with PandaPool(["a"], panda_cls=FakePanda, rx_maxlen=10) as pool:
+      p = FakePanda.opened["a"]
+      with p.lock:
+        p.rx = [(i, b"", 0) for i in range(25)]
+      self.assertTrue(wait_for(lambda: pool.stats()["a"]["rx_msgs"] == 25))
+
+      # the oldest are dropped and counted
+      self.assertEqual(pool.stats()["a"]["rx_dropped"], 15)
+      self.assertEqual(pool.can_recv("a"), [(i, b"", 0) for i in range(15, 25)])
+
+  def test_close(self):
+    pool = PandaPool(["a", "b"], panda_cls=FakePanda)
+    pool.start()
+    workers = list(pool._workers.values())
+    self.assertTrue(all(w.is_alive() for w in workers))
+    pool.close()
+    self.assertFalse(any(w.is_alive() for w in workers))
+    self.assertTrue(all(p.closed for p in FakePanda.opened.values()))
+
+    # closing a pool that was never started still closes the devices
+    FakePanda.opened = {}
+    PandaPool(["c"], panda_cls=FakePanda).close()
+    self.assertTrue(FakePanda.opened["c"].closed)
+
+
+if __name__ == "__main__":
+  unittest.main()